@@ -0,0 +1,73 @@
+#ifndef ASYMMETRIC_FENCE
+#define ASYMMETRIC_FENCE
+
+#include <atomic>
+
+#if defined(__linux__)
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// ----- Asymmetric fences
+// 
+// For Dekker style handshakes where one side runs far more often than the
+// other, e.g. readers and writers of asymmetric_shared_mutex. Each side
+// stores its own flag, calls its fence and loads the flag of the other side.
+// The frequent side calls asymmetric_fence_light(), only a compiler barrier,
+// the rare side calls asymmetric_fence_heavy(), which makes every running
+// thread of the process execute a full memory barrier with
+// membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED).
+// Without membarrier both fences are sequentially consistent fences.
+
+// asymmetric_fence_expedited
+// 
+// Set once the process is registered for expedited membarrier, until then
+// the light fence is a full fence as well
+inline std::atomic<bool> asymmetric_fence_expedited{ false };
+
+// asymmetric_fence_init()
+// 
+// Registers the process for expedited membarrier, called by the users of the
+// fences on construction so the light fence is cheap from the start.
+// Returns whether the heavy fence uses membarrier.
+inline bool asymmetric_fence_init()
+{
+	static const bool registered = [] {
+#if defined(__linux__) && defined(SYS_membarrier)
+		long commands = ::syscall(SYS_membarrier, MEMBARRIER_CMD_QUERY, 0, 0);
+		if (commands < 0 || !(commands & MEMBARRIER_CMD_PRIVATE_EXPEDITED))
+			return false;
+		if (::syscall(SYS_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) != 0)
+			return false;
+		asymmetric_fence_expedited.store(true, std::memory_order_relaxed);
+		return true;
+#else
+		return false;
+#endif
+	}();
+	return registered;
+}
+
+// a thread that still sees false uses a full fence, which is correct
+// with either kind of heavy fence
+inline void asymmetric_fence_light()
+{
+	if (asymmetric_fence_expedited.load(std::memory_order_relaxed))
+		std::atomic_signal_fence(std::memory_order_seq_cst);
+	else
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+inline void asymmetric_fence_heavy()
+{
+#if defined(__linux__) && defined(SYS_membarrier)
+	if (asymmetric_fence_init())
+	{
+		::syscall(SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0);
+		return;
+	}
+#endif
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+#endif
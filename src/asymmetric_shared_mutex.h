@@ -0,0 +1,190 @@
+#ifndef ASYMMETRIC_SHARED_MUTEX
+#define ASYMMETRIC_SHARED_MUTEX
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+
+#include "asymmetric_fence.h"
+#include "protected_data.h"
+
+// asymmetric_reader_record
+// 
+// Shared locks held by one thread, written only by that thread and scanned
+// by writers. Records are linked into a global list and reused after their
+// thread exits, they are never freed.
+struct asymmetric_reader_record
+{
+	static constexpr std::size_t slots = 4;
+
+	// addresses of the asymmetric_shared_mutexes held shared, nullptr if free
+	std::atomic<const void*> held[slots] = {};
+	std::atomic<bool> in_use{ true };
+	asymmetric_reader_record* next = nullptr;
+
+	static inline std::atomic<asymmetric_reader_record*> head_{ nullptr };
+
+	static asymmetric_reader_record* acquire()
+	{
+		for (asymmetric_reader_record* r = head_.load(std::memory_order_acquire); r; r = r->next)
+		{
+			bool expected = false;
+			if (!r->in_use.load(std::memory_order_relaxed) && r->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire))
+				return r;
+		}
+		auto* r = new asymmetric_reader_record;
+		r->next = head_.load(std::memory_order_relaxed);
+		while (!head_.compare_exchange_weak(r->next, r, std::memory_order_release, std::memory_order_relaxed));
+		return r;
+	}
+
+	struct thread_record
+	{
+		asymmetric_reader_record* record = acquire();
+
+		~thread_record()
+		{
+			record->in_use.store(false, std::memory_order_release);
+		}
+	};
+
+	static asymmetric_reader_record& this_thread()
+	{
+		static thread_local thread_record r;
+		return *r.record;
+	}
+
+	template<typename F>
+	static void for_each(F&& f)
+	{
+		for (asymmetric_reader_record* r = head_.load(std::memory_order_acquire); r; r = r->next)
+			f(*r);
+	}
+};
+
+// asymmetric_shared_mutex
+// 
+// Shared mutex for extremely read dominated data. The reader path has no
+// atomic read-modify-write and no fence: a reader stores the address of the
+// mutex into a slot of its thread record, issues asymmetric_fence_light()
+// and checks the writer flag. A writer sets the flag, issues
+// asymmetric_fence_heavy() (membarrier) so that every reader either sees the
+// flag or is seen in its slot, and waits until no slot holds the mutex.
+// Readers that meet a writer clear their slot and wait on the writer mutex,
+// so writers are preferred. Writers are expensive, a membarrier system call
+// and a scan over all threads that ever took a shared lock.
+// 
+// A thread can hold up to asymmetric_reader_record::slots shared locks at
+// once on the fast path, further ones use an atomic counter.
+// 
+// e.g. protected_data<Config, asymmetric_shared_mutex>
+class asymmetric_shared_mutex
+{
+	alignas(cache_line_size) std::atomic<bool> writer_{ false };
+	// shared locks of threads whose slots were all in use
+	std::atomic<unsigned int> overflow_readers_{ 0 };
+	std::mutex writer_mutex_;
+
+	asymmetric_shared_mutex(const asymmetric_shared_mutex& other) = delete;
+	asymmetric_shared_mutex& operator=(const asymmetric_shared_mutex& other) = delete;
+
+	bool has_readers() const
+	{
+		if (overflow_readers_.load(std::memory_order_acquire) != 0)
+			return true;
+		bool found = false;
+		asymmetric_reader_record::for_each([&](const asymmetric_reader_record& r) {
+			for (auto& slot : r.held)
+				found = found || slot.load(std::memory_order_acquire) == this;
+			});
+		return found;
+	}
+
+	// returns whether the shared lock was acquired, false if a writer is active
+	bool try_enter(asymmetric_reader_record& r)
+	{
+		for (auto& slot : r.held)
+		{
+			if (slot.load(std::memory_order_relaxed) != nullptr)
+				continue;
+			slot.store(this, std::memory_order_relaxed);
+			asymmetric_fence_light();
+			if (!writer_.load(std::memory_order_acquire))
+				return true;
+			slot.store(nullptr, std::memory_order_relaxed);
+			return false;
+		}
+
+		overflow_readers_.fetch_add(1, std::memory_order_seq_cst);
+		if (!writer_.load(std::memory_order_seq_cst))
+			return true;
+		overflow_readers_.fetch_sub(1, std::memory_order_release);
+		return false;
+	}
+
+public:
+	asymmetric_shared_mutex()
+	{
+		asymmetric_fence_init();
+	}
+
+	void lock()
+	{
+		writer_mutex_.lock();
+		writer_.store(true, std::memory_order_relaxed);
+		asymmetric_fence_heavy();
+		while (has_readers())
+			std::this_thread::yield();
+	}
+
+	bool try_lock()
+	{
+		if (!writer_mutex_.try_lock())
+			return false;
+		writer_.store(true, std::memory_order_relaxed);
+		asymmetric_fence_heavy();
+		if (!has_readers())
+			return true;
+		unlock();
+		return false;
+	}
+
+	void unlock()
+	{
+		writer_.store(false, std::memory_order_release);
+		writer_mutex_.unlock();
+	}
+
+	void lock_shared()
+	{
+		auto& r = asymmetric_reader_record::this_thread();
+		while (!try_enter(r))
+		{
+			// sleeps until the writer unlocks
+			std::lock_guard lk(writer_mutex_);
+		}
+	}
+
+	bool try_lock_shared()
+	{
+		return try_enter(asymmetric_reader_record::this_thread());
+	}
+
+	void unlock_shared()
+	{
+		auto& r = asymmetric_reader_record::this_thread();
+		// release: the reads of the critical section happen before the
+		// writer that sees the slot cleared, a plain store on x86
+		for (std::size_t i = asymmetric_reader_record::slots; i-- > 0;)
+		{
+			if (r.held[i].load(std::memory_order_relaxed) == this)
+			{
+				r.held[i].store(nullptr, std::memory_order_release);
+				return;
+			}
+		}
+		overflow_readers_.fetch_sub(1, std::memory_order_release);
+	}
+};
+#endif
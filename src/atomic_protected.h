@@ -0,0 +1,80 @@
+#ifndef ATOMIC_PROTECTED
+#define ATOMIC_PROTECTED
+
+#include <atomic>
+#include <functional>
+#include <type_traits>
+
+#include "protected_data.h"
+
+// atomic_protected<T>
+// 
+// T : trivially copyable object type whose std::atomic is lock-free
+// 
+// Lock-free backend with the callback API of protected_data. read(f) and
+// get_shared() work on a loaded copy, write(f) applies f to a copy and
+// publishes it with compare-exchange, so f may run more than once and must
+// not have side effects other than on its argument.
+// There is no get_unique(), an exclusive guard would need a lock.
+template<typename T>
+requires std::is_trivially_copyable_v<T>
+class atomic_protected
+{
+	std::atomic<T> object_;
+
+	static_assert(std::atomic<T>::is_always_lock_free, "atomic_protected requires a lock-free std::atomic<T>");
+
+	atomic_protected(const atomic_protected& other) = delete;
+	atomic_protected& operator=(const atomic_protected& other) = delete;
+
+public:
+	using value_type = T;
+
+	template<typename... Args>
+	atomic_protected(Args&&... args) : object_(T(std::forward<Args>(args)...)) {};
+
+	// get_shared()
+	// 
+	// Returns a snapshot_guard with the current value
+	snapshot_guard<T> get_shared() const
+	{
+		return snapshot_guard<T>(object_.load(std::memory_order_acquire));
+	}
+
+	// read(f)
+	// 
+	// Calls f with the current value and returns the result of f by value
+	template<typename F>
+	auto read(F&& f) const
+	{
+		const T copy = object_.load(std::memory_order_acquire);
+		return std::invoke(std::forward<F>(f), copy);
+	}
+
+	// write(f)
+	// 
+	// Calls f with a copy of the current value and publishes it,
+	// retries with the new value if another writer got in between
+	template<typename F>
+	auto write(F&& f)
+	{
+		T expected = object_.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			T desired = expected;
+			if constexpr (std::is_void_v<std::invoke_result_t<F&, T&>>)
+			{
+				std::invoke(f, desired);
+				if (object_.compare_exchange_weak(expected, desired, std::memory_order_acq_rel, std::memory_order_relaxed))
+					return;
+			}
+			else
+			{
+				auto result = std::invoke(f, desired);
+				if (object_.compare_exchange_weak(expected, desired, std::memory_order_acq_rel, std::memory_order_relaxed))
+					return result;
+			}
+		}
+	}
+};
+#endif
@@ -0,0 +1,43 @@
+#ifndef AUTO_PROTECTED
+#define AUTO_PROTECTED
+
+#include <shared_mutex>
+#include <type_traits>
+
+#include "protected_data.h"
+#include "seqlock.h"
+
+// objects up to this size are copied by seqlock readers,
+// larger ones are protected by a reader-writer lock
+constexpr std::size_t auto_protected_seqlock_max_size = 2 * cache_line_size;
+
+// auto_protected_backend<T>
+// 
+// Selects the synchronization backend for T at compile time:
+// - seqlock_protected<T> if T is trivially copyable and small
+// - protected_data<T, std::shared_mutex> otherwise
+// atomic_protected is not chosen, it has no get_unique() and generic code
+// must compile with every backend.
+template<typename T>
+struct auto_protected_backend
+{
+private:
+	static auto select()
+	{
+		if constexpr (std::is_trivially_copyable_v<T> && sizeof(T) <= auto_protected_seqlock_max_size)
+			return std::type_identity<seqlock_protected<T>>{};
+		else
+			return std::type_identity<protected_data<T, std::shared_mutex>>{};
+	}
+
+public:
+	using type = typename decltype(select())::type;
+};
+
+// auto_protected<T>
+// 
+// Protected T with the backend chosen by auto_protected_backend.
+// All backends provide get_unique(), get_shared(), read(f) and write(f).
+template<typename T>
+using auto_protected = typename auto_protected_backend<T>::type;
+#endif
@@ -0,0 +1,366 @@
+// bench_compare : flags significant changes between two benchmark result files
+//
+// usage: bench_compare baseline.csv candidate.csv [alpha] [min_change_percent]
+//        bench_compare --self-check results.csv [alpha] [min_change_percent]
+// Reads the CSV written by benchmark, groups the runs by configuration and
+// compares throughput and latency percentiles of baseline and candidate with
+// a two-sided Mann-Whitney U test and a bootstrap confidence interval of the
+// relative change of the medians. The p-values of all config and metric
+// pairs are adjusted with the Holm-Bonferroni method, so alpha bounds the
+// chance of any false report over the whole comparison. A change is only
+// reported when its adjusted p is below alpha (default 0.05), its confidence
+// interval excludes 0 and it is at least min_change_percent (default 1).
+// Exits with 1 if any metric regressed.
+//
+// --self-check compares the even runs of one file with its odd runs, which
+// come from the same build, and exits with 1 if any change is reported.
+// Run it on a baseline to check that the gate doesn't flag noise.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+constexpr int bootstrap_resamples = 4000;
+// with fewer runs per side the U test can't reach the usual significance levels
+constexpr size_t min_runs = 5;
+
+struct metric
+{
+    const char* name;
+    // column in the CSV
+    size_t column;
+    bool higher_is_better;
+};
+
+const metric metrics[] = {
+    { "ops_per_s", 4, true },
+    { "p50_ns", 5, false },
+    { "p99_ns", 6, false },
+};
+
+// runs of one configuration, one vector per metric
+using samples = vector<vector<double>>;
+
+// read_results()
+//
+// Returns false if the file can't be opened, skips the header and malformed lines
+bool read_results(const char* path, map<string, samples>& results)
+{
+    ifstream in(path);
+    if (!in)
+        return false;
+    string line;
+    while (getline(in, line))
+    {
+        vector<string> fields;
+        stringstream ss(line);
+        string field;
+        while (getline(ss, field, ','))
+            fields.push_back(field);
+        if (fields.size() != 7 || fields[0] == "config")
+            continue;
+        // all columns are parsed before the run is added, so the vectors of
+        // a config stay the same length
+        array<double, size(metrics)> values;
+        try
+        {
+            for (size_t m = 0; m < size(metrics); ++m)
+                values[m] = stod(fields[metrics[m].column]);
+        }
+        catch (const exception&)
+        {
+            continue;
+        }
+        samples& s = results[fields[0]];
+        s.resize(size(metrics));
+        for (size_t m = 0; m < size(metrics); ++m)
+            s[m].push_back(values[m]);
+    }
+    return true;
+}
+
+double median(vector<double> v)
+{
+    size_t mid = v.size() / 2;
+    nth_element(v.begin(), v.begin() + mid, v.end());
+    double upper = v[mid];
+    if (v.size() % 2)
+        return upper;
+    return (*max_element(v.begin(), v.begin() + mid) + upper) / 2;
+}
+
+// mann_whitney_p()
+//
+// Two-sided p-value of the Mann-Whitney U test. Exact distribution of U for
+// small samples without ties, normal approximation with tie and continuity
+// correction otherwise.
+double mann_whitney_p(const vector<double>& a, const vector<double>& b)
+{
+    const size_t n1 = a.size(), n2 = b.size(), n = n1 + n2;
+    vector<pair<double, int>> all;
+    for (double x : a)
+        all.push_back({ x, 0 });
+    for (double x : b)
+        all.push_back({ x, 1 });
+    sort(all.begin(), all.end());
+
+    // midranks of ties
+    double rank_sum_a = 0, tie_term = 0;
+    bool ties = false;
+    for (size_t i = 0; i < n; )
+    {
+        size_t j = i;
+        while (j < n && all[j].first == all[i].first)
+            ++j;
+        double t = static_cast<double>(j - i);
+        double rank = (i + 1 + j) / 2.0;
+        for (size_t k = i; k < j; ++k)
+            if (all[k].second == 0)
+                rank_sum_a += rank;
+        tie_term += t * t * t - t;
+        ties = ties || t > 1;
+        i = j;
+    }
+    const double u = rank_sum_a - n1 * (n1 + 1) / 2.0;
+    const double mean = n1 * n2 / 2.0;
+
+    if (!ties && n1 <= 20 && n2 <= 20)
+    {
+        // ways[i][j][u]: arrangements of i values of a and j values of b with statistic u
+        const size_t max_u = n1 * n2;
+        vector<vector<vector<double>>> ways(n1 + 1, vector<vector<double>>(n2 + 1, vector<double>(max_u + 1, 0)));
+        for (size_t i = 0; i <= n1; ++i)
+        {
+            for (size_t j = 0; j <= n2; ++j)
+            {
+                if (i == 0 || j == 0)
+                {
+                    ways[i][j][0] = 1;
+                    continue;
+                }
+                // the largest value belongs to a (and beats all j of b) or to b
+                for (size_t k = 0; k <= i * j; ++k)
+                    ways[i][j][k] = (k >= j ? ways[i - 1][j][k - j] : 0) + ways[i][j - 1][k];
+            }
+        }
+        const auto& dist = ways[n1][n2];
+        double total = accumulate(dist.begin(), dist.end(), 0.0);
+        double extreme = min(u, max_u - u);
+        double tail = 0;
+        for (size_t k = 0; k <= static_cast<size_t>(extreme); ++k)
+            tail += dist[k];
+        return min(1.0, 2 * tail / total);
+    }
+
+    double variance = n1 * n2 / 12.0 * ((n + 1) - tie_term / (n * (n - 1.0)));
+    if (variance <= 0)
+        return 1;
+    double z = (abs(u - mean) - 0.5) / sqrt(variance);
+    return erfc(max(z, 0.0) / sqrt(2.0));
+}
+
+// bootstrap_change()
+//
+// 95% confidence interval of the relative change of the median from a to b
+pair<double, double> bootstrap_change(const vector<double>& a, const vector<double>& b, mt19937_64& random)
+{
+    vector<double> changes;
+    changes.reserve(bootstrap_resamples);
+    vector<double> ra(a.size()), rb(b.size());
+    uniform_int_distribution<size_t> pick_a(0, a.size() - 1), pick_b(0, b.size() - 1);
+    for (int i = 0; i < bootstrap_resamples; ++i)
+    {
+        for (auto& x : ra)
+            x = a[pick_a(random)];
+        for (auto& x : rb)
+            x = b[pick_b(random)];
+        double base = median(ra);
+        if (base != 0)
+            changes.push_back(median(rb) / base - 1);
+    }
+    if (changes.empty())
+        return { 0, 0 };
+    sort(changes.begin(), changes.end());
+    return { changes[static_cast<size_t>(0.025 * (changes.size() - 1))], changes[static_cast<size_t>(0.975 * (changes.size() - 1))] };
+}
+
+// holm_adjust()
+//
+// Holm-Bonferroni adjusted p-values, in the order of p
+vector<double> holm_adjust(const vector<double>& p)
+{
+    vector<size_t> order(p.size());
+    iota(order.begin(), order.end(), 0);
+    sort(order.begin(), order.end(), [&](size_t x, size_t y) { return p[x] < p[y]; });
+    vector<double> adjusted(p.size());
+    double running = 0;
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        running = max(running, min(1.0, (p.size() - i) * p[order[i]]));
+        adjusted[order[i]] = running;
+    }
+    return adjusted;
+}
+
+struct comparison
+{
+    string config;
+    size_t metric;
+    double median_a = 0, median_b = 0, change = 0, low = 0, high = 0, p = 1, adjusted_p = 1;
+    bool enough_runs = false;
+};
+
+// compare()
+//
+// Prints the report and returns the number of regressions and improvements
+pair<int, int> compare(const map<string, samples>& baseline, const map<string, samples>& candidate, double alpha, double min_change)
+{
+    // fixed seed, the same files always give the same report
+    mt19937_64 random(42);
+    vector<comparison> rows;
+    vector<string> missing;
+
+    for (auto& [config, base] : baseline)
+    {
+        auto it = candidate.find(config);
+        if (it == candidate.end())
+        {
+            missing.push_back(config + " missing in candidate");
+            continue;
+        }
+        const samples& cand = it->second;
+        // split_runs() leaves a side empty for a config with a single run
+        if (base.empty() || base[0].empty() || cand.empty() || cand[0].empty())
+        {
+            missing.push_back(config + " has no runs in " + (base.empty() || base[0].empty() ? "baseline" : "candidate"));
+            continue;
+        }
+        for (size_t m = 0; m < size(metrics); ++m)
+        {
+            const vector<double>& a = base[m];
+            const vector<double>& b = cand[m];
+            comparison c{ config, m };
+            c.median_a = median(a);
+            c.median_b = median(b);
+            c.change = c.median_a != 0 ? c.median_b / c.median_a - 1 : 0;
+            tie(c.low, c.high) = bootstrap_change(a, b, random);
+            c.p = mann_whitney_p(a, b);
+            c.enough_runs = a.size() >= min_runs && b.size() >= min_runs;
+            rows.push_back(c);
+        }
+    }
+    for (auto& [config, cand] : candidate)
+        if (!baseline.count(config))
+            missing.push_back(config + " missing in baseline");
+
+    // only the tests that can lead to a verdict count for the correction
+    vector<double> tested;
+    for (auto& c : rows)
+        if (c.enough_runs)
+            tested.push_back(c.p);
+    vector<double> adjusted = holm_adjust(tested);
+    for (size_t i = 0, t = 0; i < rows.size(); ++i)
+        if (rows[i].enough_runs)
+            rows[i].adjusted_p = adjusted[t++];
+
+    int regressions = 0, improvements = 0;
+    cout << left << setw(40) << "config" << setw(11) << "metric" << right << setw(14) << "baseline" << setw(14) << "candidate"
+        << setw(9) << "change" << setw(20) << "95% CI" << setw(9) << "p" << setw(9) << "adj p" << "  verdict" << endl;
+    for (auto& c : rows)
+    {
+        string verdict = "no significant change";
+        if (!c.enough_runs)
+            verdict = "too few runs";
+        else if (c.adjusted_p < alpha && (c.low > 0 || c.high < 0) && abs(c.change) >= min_change)
+        {
+            bool better = (c.change > 0) == metrics[c.metric].higher_is_better;
+            verdict = better ? "improvement" : "REGRESSION";
+            ++(better ? improvements : regressions);
+        }
+
+        ostringstream ci;
+        ci << fixed << setprecision(1) << showpos << "[" << c.low * 100 << "%, " << c.high * 100 << "%]";
+        cout << left << setw(40) << c.config << setw(11) << metrics[c.metric].name << right << fixed << setprecision(0)
+            << setw(14) << c.median_a << setw(14) << c.median_b << setprecision(1) << showpos << setw(8) << c.change * 100 << "%" << noshowpos
+            << setw(20) << ci.str() << setprecision(3) << setw(9) << c.p << setw(9) << c.adjusted_p << "  " << verdict << endl;
+    }
+    for (auto& line : missing)
+        cout << line << endl;
+
+    cout << regressions << " regressions, " << improvements << " improvements" << endl;
+    return { regressions, improvements };
+}
+
+// split_runs()
+//
+// Splits the runs of every configuration into the even and the odd ones,
+// benchmark interleaves its configurations so both halves saw the same conditions
+void split_runs(const map<string, samples>& results, map<string, samples>& even, map<string, samples>& odd)
+{
+    for (auto& [config, s] : results)
+    {
+        samples& e = even[config];
+        samples& o = odd[config];
+        e.resize(s.size());
+        o.resize(s.size());
+        for (size_t m = 0; m < s.size(); ++m)
+            for (size_t i = 0; i < s[m].size(); ++i)
+                (i % 2 ? o : e)[m].push_back(s[m][i]);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const bool self_check = argc > 1 && string(argv[1]) == "--self-check";
+    if (argc < 3)
+    {
+        cerr << "usage: bench_compare baseline.csv candidate.csv [alpha] [min_change_percent]" << endl;
+        cerr << "       bench_compare --self-check results.csv [alpha] [min_change_percent]" << endl;
+        return 2;
+    }
+    const double alpha = argc > 3 ? atof(argv[3]) : 0.05;
+    const double min_change = (argc > 4 ? atof(argv[4]) : 1.0) / 100;
+
+    if (self_check)
+    {
+        map<string, samples> results, even, odd;
+        if (!read_results(argv[2], results))
+        {
+            cerr << "cannot open " << argv[2] << endl;
+            return 2;
+        }
+        split_runs(results, even, odd);
+        auto [regressions, improvements] = compare(even, odd, alpha, min_change);
+        bool passed = regressions == 0 && improvements == 0;
+        cout << "self-check " << (passed ? "passed" : "FAILED, same build reported as changed") << endl;
+        return passed ? 0 : 1;
+    }
+
+    map<string, samples> baseline, candidate;
+    for (auto [path, results] : { pair{ argv[1], &baseline }, pair{ argv[2], &candidate } })
+    {
+        if (!read_results(path, *results))
+        {
+            cerr << "cannot open " << path << endl;
+            return 2;
+        }
+    }
+
+    auto [regressions, improvements] = compare(baseline, candidate, alpha, min_change);
+    return regressions ? 1 : 0;
+}
@@ -0,0 +1,152 @@
+// benchmark : throughput and latency of the protected_data backends
+//
+// usage: benchmark [runs] [duration_ms] [threads] > results.csv
+// Every configuration (backend, threads, share of writes) is run the given
+// number of times. The runs are interleaved across configurations, so slow
+// drifts of the machine spread over all of them instead of biasing one.
+// Writes one CSV line per run, compare two result files with bench_compare.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "protected_data.h"
+#include "seqlock.h"
+#include "spin_lock.h"
+#include "asymmetric_shared_mutex.h"
+#include "reader_combining.h"
+
+using namespace std;
+using bench_clock = chrono::steady_clock;
+
+struct bench_object
+{
+    uint64_t values[4] = {};
+};
+
+// every latency_sample_rate-th operation of a thread is timed
+constexpr unsigned int latency_sample_rate = 16;
+
+struct run_result
+{
+    double ops_per_s = 0;
+    double p50_ns = 0;
+    double p99_ns = 0;
+};
+
+struct configuration
+{
+    string name;
+    unsigned int threads;
+    unsigned int write_percent;
+    function<run_result(const configuration&, chrono::milliseconds)> run;
+};
+
+template <typename P>
+run_result run_backend(const configuration& c, chrono::milliseconds duration)
+{
+    auto backend = make_unique<P>();
+    atomic<bool> start{ false }, stop{ false };
+    vector<uint64_t> ops(c.threads, 0);
+    vector<vector<uint32_t>> latencies(c.threads);
+
+    auto worker = [&](unsigned int index) {
+        uint64_t state = index * 0x9e3779b97f4a7c15ull + 1;
+        uint64_t n = 0, sink = 0;
+        auto& samples = latencies[index];
+        while (!start.load(memory_order_acquire))
+            this_thread::yield();
+        while (!stop.load(memory_order_relaxed))
+        {
+            // xorshift, cheaper than <random> in the measured loop
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            bool write = state % 100 < c.write_percent;
+            bool timed = n % latency_sample_rate == 0;
+            auto begin = timed ? bench_clock::now() : bench_clock::time_point();
+
+            if (write)
+                backend->write([](bench_object& o) { for (auto& v : o.values) ++v; });
+            else
+                sink += backend->read([](const bench_object& o) { return o.values[0] + o.values[3]; });
+
+            if (timed)
+                samples.push_back(static_cast<uint32_t>(min<int64_t>(chrono::duration_cast<chrono::nanoseconds>(bench_clock::now() - begin).count(), UINT32_MAX)));
+            ++n;
+        }
+        ops[index] = n + (sink == 1);
+    };
+
+    vector<thread> threads;
+    for (unsigned int i = 0; i < c.threads; ++i)
+        threads.emplace_back(worker, i);
+    auto began = bench_clock::now();
+    start.store(true, memory_order_release);
+    this_thread::sleep_for(duration);
+    stop.store(true, memory_order_relaxed);
+    for (auto& t : threads)
+        t.join();
+    double seconds = chrono::duration<double>(bench_clock::now() - began).count();
+
+    vector<uint32_t> all;
+    for (auto& l : latencies)
+        all.insert(all.end(), l.begin(), l.end());
+    run_result r;
+    for (uint64_t n : ops)
+        r.ops_per_s += n;
+    r.ops_per_s /= seconds;
+    if (!all.empty())
+    {
+        auto at = [&](double q) {
+            auto it = all.begin() + static_cast<ptrdiff_t>(q * (all.size() - 1));
+            nth_element(all.begin(), it, all.end());
+            return static_cast<double>(*it);
+        };
+        r.p50_ns = at(0.5);
+        r.p99_ns = at(0.99);
+    }
+    return r;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int runs = argc > 1 ? atoi(argv[1]) : 10;
+    chrono::milliseconds duration(argc > 2 ? atoi(argv[2]) : 200);
+    unsigned int max_threads = argc > 3 ? atoi(argv[3]) : max(thread::hardware_concurrency(), 2u);
+
+    vector<configuration> configurations;
+    auto add = [&]<typename P>(const string& backend) {
+        for (unsigned int threads : { 1u, max_threads })
+            for (unsigned int write_percent : { 10u, 50u })
+                configurations.push_back({ backend + "/t" + to_string(threads) + "/w" + to_string(write_percent),
+                    threads, write_percent, run_backend<P> });
+    };
+    add.operator()<protected_data<bench_object, mutex>>("mutex");
+    add.operator()<protected_data<bench_object, shared_mutex>>("shared_mutex");
+    add.operator()<protected_data<bench_object, spin_lock, cache_aligned>>("spin_lock");
+    add.operator()<protected_data<bench_object, asymmetric_shared_mutex>>("asymmetric_shared_mutex");
+    add.operator()<protected_data<bench_object, reader_combining<shared_mutex>>>("reader_combining");
+    add.operator()<seqlock_protected<bench_object>>("seqlock_protected");
+
+    cout << "config,run,threads,write_percent,ops_per_s,p50_ns,p99_ns" << endl;
+    for (unsigned int run = 0; run < runs; ++run)
+    {
+        for (auto& c : configurations)
+        {
+            run_result r = c.run(c, duration);
+            cout << c.name << ',' << run << ',' << c.threads << ',' << c.write_percent << ','
+                << static_cast<uint64_t>(r.ops_per_s) << ',' << r.p50_ns << ',' << r.p99_ns << endl;
+        }
+    }
+}
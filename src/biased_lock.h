@@ -0,0 +1,193 @@
+#ifndef BIASED_LOCK
+#define BIASED_LOCK
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+
+#include "asymmetric_fence.h"
+#include "asymmetric_shared_mutex.h"
+#include "protected_data.h"
+
+// biased<M, BiasAfter>
+// 
+// M : underlying mutex type
+// BiasAfter : number of consecutive acquisitions by one thread after which
+//             the lock becomes biased to that thread
+// 
+// Biased locking for objects that are almost always used by the same thread.
+// Once biased, the owner thread acquires and releases the lock with plain
+// stores into a slot of its asymmetric_reader_record and a compiler-only
+// asymmetric_fence_light(), M is not touched.
+// Any other thread revokes the bias first. It locks M, clears the owner,
+// issues asymmetric_fence_heavy() (membarrier) and waits until the owner has
+// left its critical section. After that the lock behaves like M until one
+// thread again acquires it BiasAfter times in a row. An instance that was
+// revoked max_revocations times stays unbiased, so objects that
+// really are shared don't pay for a membarrier per handover.
+// 
+// Shared acquisitions by the owner use the biased fast path, those by other
+// threads revoke the bias like exclusive ones.
+// 
+// e.g. protected_data<std::vector<int>, biased<std::mutex>> other_values;
+template<typename M, unsigned int BiasAfter = 64>
+requires Lockable<M>
+class biased
+{
+	static constexpr unsigned int max_revocations = 8;
+
+	M mutex_;
+	// thread the lock is biased to, written under mutex_
+	std::atomic<std::thread::id> owner_;
+	// protected by mutex_
+	std::thread::id last_thread_;
+	unsigned int streak_ = 0;
+	unsigned int revocations_ = 0;
+
+	biased(const biased& other) = delete;
+	biased& operator=(const biased& other) = delete;
+
+	static std::atomic<const void*>* free_slot(asymmetric_reader_record& r)
+	{
+		for (auto& slot : r.held)
+			if (slot.load(std::memory_order_relaxed) == nullptr)
+				return &slot;
+		return nullptr;
+	}
+
+	bool try_enter_biased(std::thread::id self)
+	{
+		if (owner_.load(std::memory_order_relaxed) != self)
+			return false;
+		auto* slot = free_slot(asymmetric_reader_record::this_thread());
+		if (!slot)
+			return false;
+		slot->store(this, std::memory_order_relaxed);
+		asymmetric_fence_light();
+		if (owner_.load(std::memory_order_relaxed) == self)
+			return true;
+		slot->store(nullptr, std::memory_order_relaxed);
+		return false;
+	}
+
+	// returns whether the calling thread holds the lock on the fast path
+	// and releases it in that case
+	bool leave_biased()
+	{
+		auto& r = asymmetric_reader_record::this_thread();
+		for (std::size_t i = asymmetric_reader_record::slots; i-- > 0;)
+		{
+			if (r.held[i].load(std::memory_order_relaxed) == this)
+			{
+				r.held[i].store(nullptr, std::memory_order_release);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool owner_inside() const
+	{
+		bool found = false;
+		asymmetric_reader_record::for_each([&](const asymmetric_reader_record& r) {
+			for (auto& slot : r.held)
+				found = found || slot.load(std::memory_order_acquire) == this;
+			});
+		return found;
+	}
+
+	// called with mutex_ held exclusively
+	void revoke()
+	{
+		owner_.store(std::thread::id(), std::memory_order_relaxed);
+		asymmetric_fence_heavy();
+		// acquire: the writes of the owner's critical section are visible
+		while (owner_inside())
+			std::this_thread::yield();
+		++revocations_;
+	}
+
+	// called with mutex_ held exclusively, returns whether the acquisition
+	// was turned into a biased one and mutex_ released
+	bool count_acquisition(std::thread::id self)
+	{
+		if (revocations_ >= max_revocations)
+			return false;
+		if (last_thread_ != self)
+		{
+			last_thread_ = self;
+			streak_ = 0;
+		}
+		if (++streak_ < BiasAfter)
+			return false;
+		auto* slot = free_slot(asymmetric_reader_record::this_thread());
+		if (!slot)
+			return false;
+		slot->store(this, std::memory_order_relaxed);
+		owner_.store(self, std::memory_order_relaxed);
+		mutex_.unlock();
+		return true;
+	}
+
+	void lock_exclusive(std::thread::id self)
+	{
+		mutex_.lock();
+		if (owner_.load(std::memory_order_relaxed) != std::thread::id())
+			revoke();
+		count_acquisition(self);
+	}
+
+public:
+	biased()
+	{
+		asymmetric_fence_init();
+	}
+
+	void lock()
+	{
+		auto self = std::this_thread::get_id();
+		if (!try_enter_biased(self))
+			lock_exclusive(self);
+	}
+
+	void unlock()
+	{
+		if (!leave_biased())
+			mutex_.unlock();
+	}
+
+	void lock_shared() requires SharedLockable<M>
+	{
+		auto self = std::this_thread::get_id();
+		if (try_enter_biased(self))
+			return;
+		while (true)
+		{
+			mutex_.lock_shared();
+			// the bias is only set under the exclusive lock
+			if (owner_.load(std::memory_order_relaxed) == std::thread::id())
+				return;
+			mutex_.unlock_shared();
+
+			mutex_.lock();
+			if (owner_.load(std::memory_order_relaxed) != std::thread::id())
+				revoke();
+			mutex_.unlock();
+		}
+	}
+
+	void unlock_shared() requires SharedLockable<M>
+	{
+		if (!leave_biased())
+			mutex_.unlock_shared();
+	}
+
+	// is_biased_to_this_thread()
+	// 
+	// Returns whether the calling thread can acquire the lock on the fast path
+	bool is_biased_to_this_thread() const
+	{
+		return owner_.load(std::memory_order_relaxed) == std::this_thread::get_id();
+	}
+};
+#endif
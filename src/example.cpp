@@ -8,12 +8,22 @@
 #include <iostream>
 
 #include "protected_data.h"
+#include "protected_registry.h"
+#include "nested_lock.h"
+#include "protected_column.h"
+#include "protected_log.h"
+#include "lock_stats_dump.h"
+#include "stale_readable.h"
 
 using namespace std;
 
+// shared_mutex with lock inheritance: protected_data members of an object
+// that is exclusively held by the current thread don't lock again
+using shape_mutex = nested_lock<std::shared_mutex>;
+
 // alias for protected_data with shared_mutex
 template <typename T>
-using shared_protected_data = protected_data<T, std::shared_mutex>;
+using shared_protected_data = protected_data<T, shape_mutex>;
 
 class Shape
 {
@@ -32,7 +42,8 @@ class Square : public Shape
 {
     int edge;
     // mark protected_data members as mutable to support safe manipulation in outer shared_guard
-    mutable shared_protected_data<vector<int>> other_values;
+    // values are stored contiguously, aggregations run vectorized under one shared lock
+    mutable protected_column<int, shape_mutex> other_values;
 
 public:
     Square(int _edge) : Shape("square"), edge(_edge) {};
@@ -54,17 +65,35 @@ public:
         return guard->size();
     }
 
+    long long get_sum_of_values() const
+    {
+        return other_values.sum();
+    }
+
 
 };
 
+// memory of the registered shapes is accounted under this group
+struct shape_footprint
+{
+    static constexpr const char* footprint_name = "shapes";
+};
+
+// non-owning handle to a protected Shape (or a class derived from Shape)
+using shape_handle = protected_handle<Shape, shape_mutex>;
+
 class ShapeManager
 {
-    vector<shared_ptr<shared_protected_data<Shape>>> shapes;
+    // shapes are bucketed by their type, each bucket is stored contiguously
+    protected_registry<Shape, shape_mutex, footprint_accounting<shape_footprint>> shapes;
+    // secondary index, finds shapes by name without locking every shape
+    registry_index<Shape, shape_mutex, string, decltype(&Shape::get_name)>& by_name = shapes.add_index<string>(&Shape::get_name);
 
 public:
-    void add_shape(shared_ptr<shared_protected_data<Shape>> const& pShape)
+    template <typename S, typename... Args>
+    shape_handle add_shape(Args&&... args)
     {
-        shapes.push_back(pShape);
+        return shapes.emplace<S>(std::forward<Args>(args)...);
     }
 
     int get_n_shapes() const
@@ -72,12 +101,27 @@ public:
         return shapes.size();
     }
 
-    shared_ptr<shared_protected_data<Shape>> get_shape_at(unsigned int index)
+    shape_handle get_shape_at(unsigned int index)
+    {
+        return shapes.at(index);
+    }
+
+    // exclusive access through the manager keeps the name index up to date
+    auto get_unique(const shape_handle& shape) const
+    {
+        return shapes.get_unique(shape);
+    }
+
+    vector<shape_handle> find_shapes(const string& name) const
+    {
+        return by_name.find(name);
+    }
+
+    // calls f with a handle of every shape of exact type S, without casting
+    template <typename S, typename F>
+    void for_each_shape(F&& f) const
     {
-        if (index < shapes.size())
-            return shapes[index];
-        else
-            return nullptr;
+        shapes.for_each<S>(std::forward<F>(f));
     }
 };
 
@@ -88,13 +132,10 @@ int main() {
 
     ShapeManager manager;
 
-    manager.add_shape(make_shared<shared_protected_data<Shape>>("generic1"));
-    {
-        auto square_ptr = make_shared<shared_protected_data<Square>>(5);
-        manager.add_shape(cast_shared_ptr_protected_data<Shape>(square_ptr).value());
-    }
-    manager.add_shape(make_shared<shared_protected_data<Shape>>("generic2"));
-    manager.add_shape(make_shared<shared_protected_data<Shape>>());
+    manager.add_shape<Shape>("generic1");
+    manager.add_shape<Square>(5);
+    manager.add_shape<Shape>("generic2");
+    manager.add_shape<Shape>();
 
     int N = manager.get_n_shapes();
     for (unsigned int i = 0; i < N; ++i)
@@ -102,20 +143,20 @@ int main() {
         cout << i << endl;
         if (auto pShape = manager.get_shape_at(i))
         {
-            // now we have another shared_ptr, to use it we need to lock the guard
+            // now we have a handle, to use it we need to lock the guard
             {
-                auto s_guard = pShape->get_shared();
+                auto s_guard = pShape.get_shared();
                 cout << s_guard->get_name() << endl;
                 // cannot call s_guard->set_name()
             }
 
             thread* t = nullptr;
             {
-                auto u_guard = pShape->get_unique();
+                auto u_guard = manager.get_unique(pShape);
 
                 // below thread will wait until current guard is out of scope
                 t = new thread([pShape]() {
-                    auto s_guard = pShape->get_shared();
+                    auto s_guard = pShape.get_shared();
                     cout << "Writing from thread : " << s_guard->get_name() << endl;
                     });
 
@@ -130,46 +171,85 @@ int main() {
                 delete t;
             }
 
-            if (auto s_sq_guard = pShape->get_shared_cast<Square>())
+            if (auto s_sq_guard = pShape.get_shared_cast<Square>())
             {
                 auto& s_guard = s_sq_guard.value();
                 // below works because we already protect inner vector
                 s_guard->add_value(10);
                 // but below doesn't compile
                 // s_sq_guard.value()->set_edge(10);
-                cout << "Edge of square : " << s_guard->get_edge() << " N values: " << s_guard->get_number_of_values() << endl;
+                cout << "Edge of square : " << s_guard->get_edge() << " N values: " << s_guard->get_number_of_values()
+                    << " sum: " << s_guard->get_sum_of_values() << endl;
             }
-            if (auto u_sq_guard = pShape->get_unique_cast<Square>())
+            if (auto u_sq_guard = pShape.get_unique_cast<Square>())
             {
                 auto& u_guard = u_sq_guard.value();
                 // now also below works
                 u_guard->set_edge(10);
+                // other_values inherits the lock of u_guard, add_value doesn't lock again
+                u_guard->add_value(20);
                 cout << "Edge of square : " << u_guard->get_edge() << endl;
             }
         }
     }
 
+    // lookup by name through the index, renamed shapes are found by their new name
+    for (auto& found : manager.find_shapes("generic1-1"))
+    {
+        auto s_guard = found.get_shared();
+        cout << "Found by name : " << s_guard->get_name() << endl;
+    }
+
+    // typed scan over the Square bucket only
+    manager.for_each_shape<Square>([](auto sq_handle) {
+        auto s_guard = sq_handle.get_shared();
+        cout << "Square with edge : " << s_guard->get_edge() << endl;
+        });
+
+    // a health check never waits behind a slow writer, it gets the copy
+    // published at the last exclusive unlock instead
+    protected_data<string, stale_readable<std::shared_mutex>> status("starting");
+    status.write([](string& st) { st = "running"; });
+    {
+        auto u_guard = status.get_unique();
+        thread health_check([&status]() {
+            auto s_guard = status.get_shared_or_stale();
+            cout << "Status : " << *s_guard << (s_guard.is_stale() ? " (stale)" : "") << " version " << s_guard.version() << endl;
+            });
+        health_check.join();
+        this_thread::sleep_for(chrono::milliseconds(500));
+        *u_guard = "rebalancing";
+    }
+
     // call from multiple threads
 
     auto pShape = manager.get_shape_at(0);
 
+    // threads append their lines to a shared log buffer without locking,
+    // a background flusher writes them to stdout in batches
+    protected_log log(STDOUT_FILENO);
+
     vector<thread> threads;
     threads.reserve(100);
 
     for (int i = 0; i < 10; ++i)
     {
-        threads.emplace_back([pShape, i]() {
+        threads.emplace_back([pShape, i, &log, &manager]() {
             for (int j = 0; j < 1000; ++j)
             {
                 if (j % 2)
                 {
                     this_thread::sleep_for(chrono::milliseconds(1));
-                    auto s_guard = pShape->get_shared();
-                    cout << s_guard->get_name() << endl;
+                    string line;
+                    {
+                        auto s_guard = pShape.get_shared();
+                        line = string(s_guard->get_name()) + "\n";
+                    }
+                    log.append(line);
                 }
                 else
                 {
-                    auto u_guard = pShape->get_unique();
+                    auto u_guard = manager.get_unique(pShape);
                     u_guard->set_name("threaded shape-" + to_string(i) + "-" + to_string(j));
                 }
             }
@@ -179,9 +259,15 @@ int main() {
     for (auto& t : threads)
         t.join();
 
+    log.flush();
+
 
     {
-        auto s_guard = pShape->get_shared();
+        auto s_guard = pShape.get_shared();
         cout << s_guard->get_name() << endl;
+        cout << "Shapes with that name : " << manager.find_shapes(string(s_guard->get_name())).size() << endl;
     }
+
+    // bytes used by the shapes, their mutexes and the registry slots
+    write_footprint_report(cout);
 }
\ No newline at end of file
@@ -0,0 +1,202 @@
+#ifndef FREEZABLE
+#define FREEZABLE
+
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <thread>
+
+#include "asymmetric_fence.h"
+#include "asymmetric_shared_mutex.h"
+#include "protected_data.h"
+
+// freezable<M>
+// 
+// M : underlying mutex type
+// 
+// Lock for objects that are written during a load phase and only read
+// afterwards. Until freeze() it forwards to M. After freeze() the object is
+// immutable: a shared acquisition takes no lock, it only stores the address
+// of the lock into a slot of the thread's asymmetric_reader_record and issues
+// asymmetric_fence_light(), so frozen readers never write a shared cache line.
+// Exclusive acquisitions of a frozen object throw std::logic_error and
+// try_lock() returns false.
+// 
+// thaw() is a stop-the-world operation: it blocks new readers on M, issues
+// asymmetric_fence_heavy() (membarrier) and waits until every frozen reader
+// has released its guard. It is meant for rare reconfiguration, not for a
+// regular write path.
+// 
+// drain() waits for the current holders, frozen or not, without changing the
+// state, quiescent_reclaim uses it instead of lock() so that a frozen object
+// can be destroyed.
+// 
+// Shared locking is available even if M is only Lockable, unfrozen readers
+// then take the exclusive lock of M.
+// 
+// e.g.
+// protected_data<Shape, freezable<std::shared_mutex>> shape;
+// shape.freeze();
+template<typename M>
+requires Lockable<M>
+class freezable
+{
+	M mutex_;
+	// changed only while mutex_ is held exclusively
+	alignas(cache_line_size) std::atomic<bool> frozen_{ false };
+
+	freezable(const freezable& other) = delete;
+	freezable& operator=(const freezable& other) = delete;
+
+	bool has_frozen_readers() const
+	{
+		bool found = false;
+		asymmetric_reader_record::for_each([&](const asymmetric_reader_record& r) {
+			for (auto& slot : r.held)
+				found = found || slot.load(std::memory_order_acquire) == this;
+			});
+		return found;
+	}
+
+	// returns whether the object was frozen and a slot registered the reader
+	bool try_enter_frozen()
+	{
+		auto& r = asymmetric_reader_record::this_thread();
+		for (auto& slot : r.held)
+		{
+			if (slot.load(std::memory_order_relaxed) != nullptr)
+				continue;
+			slot.store(this, std::memory_order_relaxed);
+			asymmetric_fence_light();
+			if (frozen_.load(std::memory_order_acquire))
+				return true;
+			slot.store(nullptr, std::memory_order_relaxed);
+			return false;
+		}
+		// all slots in use, the reader locks mutex_ instead
+		return false;
+	}
+
+	void lock_underlying_shared()
+	{
+		if constexpr (SharedLockable<M>)
+			mutex_.lock_shared();
+		else
+			mutex_.lock();
+	}
+
+	void unlock_underlying_shared()
+	{
+		if constexpr (SharedLockable<M>)
+			mutex_.unlock_shared();
+		else
+			mutex_.unlock();
+	}
+
+	[[noreturn]] static void throw_frozen()
+	{
+		throw std::logic_error("exclusive lock of a frozen object");
+	}
+
+public:
+	freezable()
+	{
+		asymmetric_fence_init();
+	}
+
+	void lock()
+	{
+		if (frozen_.load(std::memory_order_relaxed))
+			throw_frozen();
+		mutex_.lock();
+		if (frozen_.load(std::memory_order_relaxed))
+		{
+			mutex_.unlock();
+			throw_frozen();
+		}
+	}
+
+	bool try_lock() requires requires(M m) { { m.try_lock() } -> std::convertible_to<bool>; }
+	{
+		if (frozen_.load(std::memory_order_relaxed) || !mutex_.try_lock())
+			return false;
+		if (!frozen_.load(std::memory_order_relaxed))
+			return true;
+		mutex_.unlock();
+		return false;
+	}
+
+	void unlock()
+	{
+		mutex_.unlock();
+	}
+
+	void lock_shared()
+	{
+		if (frozen_.load(std::memory_order_relaxed) && try_enter_frozen())
+			return;
+		lock_underlying_shared();
+	}
+
+	void unlock_shared()
+	{
+		auto& r = asymmetric_reader_record::this_thread();
+		// release: the reads of the critical section happen before
+		// the thaw() that sees the slot cleared
+		for (std::size_t i = asymmetric_reader_record::slots; i-- > 0;)
+		{
+			if (r.held[i].load(std::memory_order_relaxed) == this)
+			{
+				r.held[i].store(nullptr, std::memory_order_release);
+				return;
+			}
+		}
+		unlock_underlying_shared();
+	}
+
+	// freeze()
+	// 
+	// Waits for the current holders to release the lock and makes the object
+	// immutable, later shared acquisitions take no lock
+	void freeze()
+	{
+		mutex_.lock();
+		frozen_.store(true, std::memory_order_release);
+		mutex_.unlock();
+	}
+
+	// thaw()
+	// 
+	// Stops the world: blocks new readers, waits for all frozen readers to
+	// release their guards and makes the object writable again.
+	// Must not be called by a thread that holds a shared guard of the object
+	void thaw()
+	{
+		mutex_.lock();
+		frozen_.store(false, std::memory_order_relaxed);
+		asymmetric_fence_heavy();
+		while (has_frozen_readers())
+			std::this_thread::yield();
+		mutex_.unlock();
+	}
+
+	// drain()
+	// 
+	// Waits until the guards that exist now, frozen readers included, are
+	// released. Doesn't throw on a frozen object and leaves it frozen.
+	// Must not be called by a thread that holds a shared guard of the object
+	void drain()
+	{
+		mutex_.lock();
+		asymmetric_fence_heavy();
+		while (has_frozen_readers())
+			std::this_thread::yield();
+		mutex_.unlock();
+	}
+
+	bool is_frozen() const
+	{
+		return frozen_.load(std::memory_order_acquire);
+	}
+};
+#endif
@@ -0,0 +1,60 @@
+#ifndef HANDOFF_MUTEX
+#define HANDOFF_MUTEX
+
+#include <atomic>
+#include <cstdint>
+
+#include "protected_data.h"
+
+// handoff_mutex
+// 
+// Exclusive mutex without owner affinity, it can be unlocked by another
+// thread than the one that locked it, which std::mutex forbids. Together
+// with protected_data::get_transferable() a locked object can be passed
+// between pipeline stage threads instead of being copied out and unlocked.
+// 
+// A single 32-bit word with the states unlocked, locked and locked with
+// waiters. Waiters sleep in std::atomic::wait on the word, which is a futex
+// on Linux, unlock only notifies when someone may be sleeping.
+// 
+// e.g. protected_data<Frame, handoff_mutex>
+class handoff_mutex
+{
+	static constexpr std::uint32_t unlocked = 0;
+	static constexpr std::uint32_t locked = 1;
+	static constexpr std::uint32_t contended = 2;
+
+	std::atomic<std::uint32_t> word_{ unlocked };
+
+	handoff_mutex(const handoff_mutex& other) = delete;
+	handoff_mutex& operator=(const handoff_mutex& other) = delete;
+
+public:
+	static constexpr bool transferable = true;
+
+	handoff_mutex() = default;
+
+	void lock()
+	{
+		std::uint32_t expected = unlocked;
+		if (word_.compare_exchange_strong(expected, locked, std::memory_order_acquire, std::memory_order_relaxed))
+			return;
+
+		// from now on the word says contended, so the unlocking thread wakes us
+		while (word_.exchange(contended, std::memory_order_acquire) != unlocked)
+			word_.wait(contended, std::memory_order_relaxed);
+	}
+
+	bool try_lock()
+	{
+		std::uint32_t expected = unlocked;
+		return word_.compare_exchange_strong(expected, locked, std::memory_order_acquire, std::memory_order_relaxed);
+	}
+
+	void unlock()
+	{
+		if (word_.exchange(unlocked, std::memory_order_release) == contended)
+			word_.notify_one();
+	}
+};
+#endif
@@ -0,0 +1,233 @@
+// lock_advisor : recommends a mutex type per protected_data site from recorded statistics
+//
+// usage: lock_advisor [dump.csv ...]
+// Reads the CSV dumps written by write_lock_stats() (lock_stats_dump.h) from the
+// given files or stdin, fits a queueing model to every site and prints the
+// recommended changes ordered by their estimated gain. Hints whose gain the
+// statistics can't show are listed last without an estimate.
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// cost of moving a contended cache line between cores
+constexpr double cache_transfer_ns = 60.0;
+// holds shorter than this don't benefit from concurrent readers
+constexpr double min_shared_hold_ns = 200.0;
+
+struct site_stats
+{
+    string site;
+    double object_size = 0;
+    bool trivially_copyable = false;
+    bool shared_lock = false;
+    bool cache_aligned = false;
+    double sample_rate = 1;
+    double exclusive_samples = 0;
+    double shared_samples = 0;
+    double read_samples = 0;
+    double contended_samples = 0;
+    double wait_ns = 0;
+    double exclusive_hold_ns = 0;
+    double shared_hold_ns = 0;
+    double threads = 0;
+    double elapsed_ns = 0;
+};
+
+struct recommendation
+{
+    string site;
+    string change;
+    string reason;
+    // saved thread time, nanoseconds per second of run time
+    double gain_ns_per_s;
+    // false if the statistics can't show the gain, listed separately and unranked
+    bool quantified = true;
+};
+
+// parse_line()
+//
+// Returns false for the header and malformed lines
+bool parse_line(const string& line, site_stats& s)
+{
+    vector<string> fields;
+    stringstream ss(line);
+    string field;
+    while (getline(ss, field, ','))
+        fields.push_back(field);
+    if (fields.size() != 15 || fields[0] == "site")
+        return false;
+
+    try
+    {
+        s.site = fields[0];
+        s.object_size = stod(fields[1]);
+        s.trivially_copyable = fields[2] == "1";
+        s.shared_lock = fields[3] == "1";
+        s.cache_aligned = fields[4] == "1";
+        s.sample_rate = stod(fields[5]);
+        s.exclusive_samples = stod(fields[6]);
+        s.shared_samples = stod(fields[7]);
+        s.read_samples = stod(fields[8]);
+        s.contended_samples = stod(fields[9]);
+        s.wait_ns = stod(fields[10]);
+        s.exclusive_hold_ns = stod(fields[11]);
+        s.shared_hold_ns = stod(fields[12]);
+        s.threads = stod(fields[13]);
+        s.elapsed_ns = stod(fields[14]);
+    }
+    catch (const exception&)
+    {
+        return false;
+    }
+    return s.elapsed_ns > 0 && s.exclusive_samples + s.shared_samples > 0;
+}
+
+// mean queueing delay of an M/M/1 server with utilization rho and mean service time hold
+double queue_wait(double rho, double hold)
+{
+    if (rho >= 0.99)
+        rho = 0.99;
+    return rho / (1 - rho) * hold;
+}
+
+void advise(const site_stats& s, vector<recommendation>& out)
+{
+    const double samples = s.exclusive_samples + s.shared_samples;
+    const double seconds = s.elapsed_ns / 1e9;
+
+    // acquisitions per second, estimated from the samples
+    const double writes = (s.exclusive_samples - s.read_samples) * s.sample_rate / seconds;
+    const double reads = (s.shared_samples + s.read_samples) * s.sample_rate / seconds;
+    const double acquisitions = writes + reads;
+    const double read_ratio = reads / acquisitions;
+
+    const double exclusive_hold = s.exclusive_samples > 0 ? s.exclusive_hold_ns / s.exclusive_samples : 0;
+    const double shared_hold = s.shared_samples > 0 ? s.shared_hold_ns / s.shared_samples : exclusive_hold;
+    const double read_hold = s.shared_lock ? shared_hold : exclusive_hold;
+    const double contention = s.contended_samples / samples;
+
+    // measured waiting, nanoseconds of thread time per second
+    const double measured_wait = s.wait_ns / samples * acquisitions;
+
+    // the model is calibrated to the measurement, so only the relative change
+    // between the current and the proposed lock is taken from it
+    const double write_load = writes * exclusive_hold / 1e9;
+    const double read_load = reads * read_hold / 1e9;
+    const double mean_hold = (writes * exclusive_hold + reads * read_hold) / acquisitions;
+    const double current_model = acquisitions * (s.shared_lock
+        ? queue_wait(write_load, exclusive_hold) + writes / acquisitions * queue_wait(read_load, read_hold)
+        : queue_wait(write_load + read_load, mean_hold));
+    const double calibration = current_model > 0 ? measured_wait / current_model : 1;
+
+    auto modeled = [&](double wait) { return min(measured_wait, wait * calibration); };
+    const double sharing = s.threads > 1 ? (s.threads - 1) / s.threads : 0;
+
+    // readers only wait for writers under a reader-writer lock
+    if (!s.shared_lock && read_ratio > 0.7 && read_hold >= min_shared_hold_ns && contention > 0.05)
+    {
+        double wait = acquisitions * queue_wait(write_load, exclusive_hold) + writes * queue_wait(read_load, read_hold);
+        ostringstream reason;
+        reason << fixed << setprecision(0) << read_ratio * 100 << "% reads holding " << read_hold
+            << " ns, " << contention * 100 << "% contended";
+        out.push_back({ s.site, "use a reader-writer lock (e.g. std::shared_mutex)", reason.str(), measured_wait - modeled(wait) });
+    }
+
+    // small read mostly objects: readers copy instead of writing the lock word
+    if (s.trivially_copyable && s.object_size <= 128 && read_ratio > 0.9 && s.threads > 1)
+    {
+        double lock_traffic = reads * 2 * cache_transfer_ns * sharing;
+        double copy_cost = reads * ceil(s.object_size / 64) * cache_transfer_ns * sharing * (1 - read_ratio);
+        double wait = acquisitions * queue_wait(write_load, exclusive_hold) * (1 - read_ratio);
+        ostringstream reason;
+        reason << fixed << setprecision(0) << read_ratio * 100 << "% reads of a " << s.object_size
+            << " byte trivially copyable object from " << s.threads << " threads";
+        out.push_back({ s.site, "switch to seqlock_protected (or auto_protected)", reason.str(),
+            measured_wait - modeled(wait) + lock_traffic - copy_cost });
+    }
+
+    // write heavy and contended: split the object so the load spreads over k locks
+    if (contention > 0.2 && read_ratio < 0.8 && s.threads >= 4)
+    {
+        double shards = s.threads;
+        double wait = acquisitions * (s.shared_lock
+            ? queue_wait(write_load / shards, exclusive_hold) + writes / acquisitions * queue_wait(read_load / shards, read_hold)
+            : queue_wait((write_load + read_load) / shards, mean_hold));
+        ostringstream reason;
+        reason << fixed << setprecision(0) << contention * 100 << "% contended, " << (1 - read_ratio) * 100
+            << "% writes from " << s.threads << " threads, modeled with " << shards << " shards";
+        out.push_back({ s.site, "shard the object", reason.str(), measured_wait - modeled(wait) });
+    }
+
+    // busy small objects may share their cache line with unrelated neighbours,
+    // the statistics of one site can't tell whether they do, so no gain is estimated
+    if (!s.cache_aligned && s.object_size < 64 && s.threads > 1 && acquisitions > 1e5)
+    {
+        ostringstream reason;
+        reason << fixed << setprecision(0) << acquisitions << " acquisitions/s on a " << s.object_size
+            << " byte object from " << s.threads << " threads, pays off only if neighbours on its cache line are"
+            << " contended too (check with perf c2c)";
+        out.push_back({ s.site, "consider padding to a cache line (cache_aligned policy)", reason.str(), 0, false });
+    }
+}
+
+int main(int argc, char** argv)
+{
+    vector<site_stats> sites;
+    auto read_dump = [&](istream& in) {
+        string line;
+        site_stats s;
+        while (getline(in, line))
+            if (parse_line(line, s))
+                sites.push_back(s);
+    };
+
+    if (argc < 2)
+        read_dump(cin);
+    for (int i = 1; i < argc; i++)
+    {
+        ifstream in(argv[i]);
+        if (!in)
+        {
+            cerr << "cannot open " << argv[i] << endl;
+            return 1;
+        }
+        read_dump(in);
+    }
+
+    vector<recommendation> recommendations;
+    for (auto& s : sites)
+        advise(s, recommendations);
+
+    sort(recommendations.begin(), recommendations.end(),
+        [](auto& a, auto& b) { return a.gain_ns_per_s > b.gain_ns_per_s; });
+
+    cout << sites.size() << " sites, " << recommendations.size() << " recommendations" << endl;
+    for (auto& r : recommendations)
+    {
+        if (!r.quantified || r.gain_ns_per_s <= 0)
+            continue;
+        cout << r.site << " : " << r.change << endl
+            << "    " << r.reason << endl
+            << "    estimated gain " << fixed << setprecision(2) << r.gain_ns_per_s / 1e6 << " ms thread time per second" << endl;
+    }
+
+    for (auto& s : sites)
+        if (none_of(recommendations.begin(), recommendations.end(), [&](auto& r) { return r.site == s.site && r.quantified && r.gain_ns_per_s > 0; }))
+            cout << s.site << " : keep the current lock" << endl;
+
+    for (auto& r : recommendations)
+    {
+        if (r.quantified)
+            continue;
+        cout << r.site << " : " << r.change << " (unquantified)" << endl
+            << "    " << r.reason << endl;
+    }
+}
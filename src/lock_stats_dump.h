@@ -0,0 +1,87 @@
+#ifndef LOCK_STATS_DUMP
+#define LOCK_STATS_DUMP
+
+#include <algorithm>
+#include <ostream>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "protected_data.h"
+
+// ----- Lock statistics dumps
+// 
+// CSV records of protected_data instances with a sampled_stats policy,
+// one line per site, consumed by the lock_advisor tool.
+// Columns:
+// site, object_size, trivially_copyable, shared_lock, cache_aligned,
+// sample_rate, exclusive_samples, shared_samples, read_samples, contended_samples,
+// wait_ns, exclusive_hold_ns, shared_hold_ns, threads, elapsed_ns
+
+// write_lock_stats_header()
+// 
+// Writes the CSV header line
+inline void write_lock_stats_header(std::ostream& out)
+{
+	out << "site,object_size,trivially_copyable,shared_lock,cache_aligned,"
+		"sample_rate,exclusive_samples,shared_samples,read_samples,contended_samples,"
+		"wait_ns,exclusive_hold_ns,shared_hold_ns,threads,elapsed_ns\n";
+}
+
+// write_lock_stats()
+// 
+// Writes the statistics of pd as one CSV line, site must not contain commas
+template<typename T, typename M, typename... Policies>
+void write_lock_stats(std::ostream& out, std::string_view site, const protected_data<T, M, Policies...>& pd)
+{
+	using pd_type = protected_data<T, M, Policies...>;
+	const lock_stats s = pd.stats();
+
+	out << site << ','
+		<< sizeof(T) << ','
+		<< std::is_trivially_copyable_v<T> << ','
+		<< SharedLockable<M> << ','
+		<< (pd_type::layout_policy::mutex_alignment >= cache_line_size) << ','
+		<< s.sample_rate << ','
+		<< s.exclusive_samples << ','
+		<< s.shared_samples << ','
+		<< s.read_samples << ','
+		<< s.contended_samples << ','
+		<< s.wait_ns << ','
+		<< s.exclusive_hold_ns << ','
+		<< s.shared_hold_ns << ','
+		<< s.threads << ','
+		<< s.elapsed_ns << '\n';
+}
+
+// ----- Footprint reports
+// 
+// CSV snapshot of the groups of the footprint_accounting policy, the group
+// is quoted since demangled type names contain commas. Columns:
+// group, instances, object_bytes, mutex_bytes, padding_bytes,
+// container_bytes, control_block_bytes, total_bytes
+
+// write_footprint_report()
+// 
+// Writes the header and one line per group, largest total first
+inline void write_footprint_report(std::ostream& out)
+{
+	std::vector<footprint_stats> report = footprint_report();
+	std::sort(report.begin(), report.end(), [](const footprint_stats& a, const footprint_stats& b) {
+		return a.total_bytes() > b.total_bytes();
+		});
+
+	out << "group,instances,object_bytes,mutex_bytes,padding_bytes,container_bytes,control_block_bytes,total_bytes\n";
+	for (const footprint_stats& s : report)
+	{
+		out << '"' << s.group << "\","
+			<< s.instances << ','
+			<< s.object_bytes << ','
+			<< s.mutex_bytes << ','
+			<< s.padding_bytes << ','
+			<< s.container_bytes << ','
+			<< s.control_block_bytes << ','
+			<< s.total_bytes() << '\n';
+	}
+}
+#endif
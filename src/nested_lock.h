@@ -0,0 +1,143 @@
+#ifndef NESTED_LOCK
+#define NESTED_LOCK
+
+#include <cstddef>
+
+#include "protected_data.h"
+
+// nested_lock_region
+// 
+// Address range of an object protected by a nested_lock. The regions that
+// the current thread holds exclusively are linked into a thread local stack.
+struct nested_lock_region
+{
+	const std::byte* begin_ = nullptr;
+	const std::byte* end_ = nullptr;
+	nested_lock_region* prev_ = nullptr;
+
+	static inline thread_local nested_lock_region* held_ = nullptr;
+
+	bool contains(const void* address) const
+	{
+		auto* p = static_cast<const std::byte*>(address);
+		return begin_ <= p && p < end_;
+	}
+
+	// held_by_this_thread()
+	// 
+	// Returns whether address lies inside an object that the current thread
+	// holds exclusively
+	static bool held_by_this_thread(const void* address)
+	{
+		for (nested_lock_region* r = held_; r; r = r->prev_)
+			if (r->contains(address))
+				return true;
+		return false;
+	}
+
+	void push()
+	{
+		prev_ = held_;
+		held_ = this;
+	}
+
+	void pop()
+	{
+		// guards are usually released in reverse order, unlink from the middle otherwise
+		nested_lock_region** link = &held_;
+		while (*link && *link != this)
+			link = &(*link)->prev_;
+		if (*link)
+			*link = prev_;
+	}
+};
+
+// nested_lock<M>
+// 
+// M : underlying mutex type
+// 
+// Lock inheritance for protected_data members of protected objects.
+// When the object of a protected_data<T, nested_lock<M>> is exclusively held,
+// every nested_lock inside that object is owned by the same lock, so guards
+// of nested protected_data members acquired by the holding thread become no-ops.
+// Otherwise, e.g. under a shared guard of the enclosing object, the nested
+// member locks its own mutex as usual. Works for any nesting depth.
+// 
+// All access to a nested member must happen under a guard of its enclosing
+// protected_data, an exclusive holder only excludes threads that go through it.
+// 
+// e.g.
+// class Square { mutable protected_data<vector<int>, nested_lock<shared_mutex>> other_values; };
+// protected_data<Square, nested_lock<shared_mutex>> square;
+template<typename M>
+requires Lockable<M>
+class nested_lock : nested_lock_region
+{
+	M mutex_;
+	// number of acquisitions that were skipped because an enclosing object is
+	// exclusively held, only touched by the thread that holds the enclosing lock
+	unsigned int inherited_depth_ = 0;
+
+	nested_lock(const nested_lock& other) = delete;
+	nested_lock& operator=(const nested_lock& other) = delete;
+
+	bool inherited() const
+	{
+		return held_ && held_by_this_thread(this);
+	}
+
+public:
+	nested_lock() = default;
+
+	// bind_region()
+	// 
+	// Called by protected_data with the address range of the protected object
+	void bind_region(const void* object, std::size_t size)
+	{
+		begin_ = static_cast<const std::byte*>(object);
+		end_ = begin_ + size;
+	}
+
+	void lock()
+	{
+		if (inherited())
+		{
+			++inherited_depth_;
+			return;
+		}
+		mutex_.lock();
+		push();
+	}
+
+	void unlock()
+	{
+		if (inherited_depth_ != 0)
+		{
+			--inherited_depth_;
+			return;
+		}
+		pop();
+		mutex_.unlock();
+	}
+
+	void lock_shared() requires SharedLockable<M>
+	{
+		if (inherited())
+		{
+			++inherited_depth_;
+			return;
+		}
+		mutex_.lock_shared();
+	}
+
+	void unlock_shared() requires SharedLockable<M>
+	{
+		if (inherited_depth_ != 0)
+		{
+			--inherited_depth_;
+			return;
+		}
+		mutex_.unlock_shared();
+	}
+};
+#endif
@@ -0,0 +1,245 @@
+#ifndef PERCPU_PROTECTED
+#define PERCPU_PROTECTED
+
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <type_traits>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && defined(__x86_64__) && __has_include(<sys/rseq.h>)
+#include <sys/rseq.h>
+#define PERCPU_RSEQ 1
+#else
+#define PERCPU_RSEQ 0
+#endif
+
+#include "protected_data.h"
+#include "spin_lock.h"
+
+// percpu_protected<T>
+// 
+// T : object type, one instance is kept per CPU
+// 
+// For counters and statistics updated at very high rates. Every CPU owns a
+// cache line aligned slot with its own T, so updates never bounce cache lines
+// between cores and, unlike per-thread sharding, the memory does not grow
+// with the number of threads.
+// 
+// add(&T::field, delta) of a 64-bit integral field is a restartable sequence
+// (rseq) on x86-64 Linux: the kernel aborts and restarts it when the thread
+// is preempted or migrated, so a plain add instruction on the slot of the
+// current CPU is enough, no lock prefix and no lock. Other fields, and all
+// fields without rseq, use a relaxed atomic add on the slot of sched_getcpu(). get_local() and write(f) lock the spin_lock of the
+// current CPU slot, which is only contended after a migration.
+// 
+// Reads aggregate over all slots: sum(&T::field) adds up the fields with
+// single-copy atomic loads, so it includes every add() that completed before
+// it started. read(init, fold) folds the slots one by one, each under its
+// lock, so every slot is seen in a state between two write(f) calls.
+// A field must be updated either with add() or with write(f), add() does not
+// take the slot lock.
+// 
+// e.g.
+// struct Counters { std::uint64_t requests; std::uint64_t bytes; };
+// percpu_protected<Counters> counters;
+// counters.add(&Counters::requests, 1);
+template<typename T>
+class percpu_protected
+{
+	struct alignas(cache_line_size) slot
+	{
+		spin_lock lock;
+		T object;
+	};
+
+	const std::uint32_t cpus_;
+	std::unique_ptr<slot[]> slots_;
+
+	percpu_protected(const percpu_protected& other) = delete;
+	percpu_protected& operator=(const percpu_protected& other) = delete;
+
+	static std::uint32_t configured_cpus()
+	{
+#if defined(__linux__)
+		long n = ::sysconf(_SC_NPROCESSORS_CONF);
+		if (n > 0)
+			return static_cast<std::uint32_t>(n);
+#endif
+		return std::max(std::thread::hardware_concurrency(), 1u);
+	}
+
+#if PERCPU_RSEQ
+	static rseq* rseq_area()
+	{
+		return reinterpret_cast<rseq*>(static_cast<char*>(__builtin_thread_pointer()) + __rseq_offset);
+	}
+#endif
+
+	// index of the slot of the CPU the thread currently runs on,
+	// only a hint since the thread may migrate right after
+	std::uint32_t current_cpu() const
+	{
+#if PERCPU_RSEQ
+		if (__rseq_size != 0)
+		{
+			std::uint32_t cpu = std::atomic_ref(rseq_area()->cpu_id).load(std::memory_order_relaxed);
+			if (cpu < cpus_)
+				return cpu;
+		}
+#endif
+#if defined(__linux__)
+		int cpu = ::sched_getcpu();
+		if (cpu >= 0)
+			return static_cast<std::uint32_t>(cpu) % cpus_;
+#endif
+		return static_cast<std::uint32_t>(std::hash<std::thread::id>{}(std::this_thread::get_id()) % cpus_);
+	}
+
+#if PERCPU_RSEQ
+	// adds delta to the 64-bit word at field + cpu_id * sizeof(slot),
+	// returns false if rseq is not usable and the caller has to fall back
+	bool rseq_add(std::byte* field, std::uint64_t delta)
+	{
+		static_assert(RSEQ_SIG == 0x53053053);
+
+		if (__rseq_size == 0)
+			return false;
+		rseq* rs = rseq_area();
+		const std::uint64_t stride = sizeof(slot);
+	restart:
+		// the descriptor of the critical section [1, 2) with abort handler 4,
+		// the kernel requires the signature right before the abort handler
+		asm volatile goto(
+			".pushsection __rseq_cs, \"aw\"\n\t"
+			".balign 32\n\t"
+			"3:\n\t"
+			".long 0x0, 0x0\n\t"
+			".quad 1f, (2f - 1f), 4f\n\t"
+			".popsection\n\t"
+			"leaq 3b(%%rip), %%rax\n\t"
+			"movq %%rax, %[rseq_cs]\n\t"
+			"1:\n\t"
+			"movl %[cpu_id], %%eax\n\t"
+			"cmpl %k[cpus], %%eax\n\t"
+			"jae %l[unavailable]\n\t"
+			"imulq %[stride], %%rax\n\t"
+			"addq %[delta], (%[field], %%rax)\n\t"
+			"2:\n\t"
+			".pushsection __rseq_failure, \"ax\"\n\t"
+			".long 0x53053053\n\t"
+			"4:\n\t"
+			"jmp %l[restart]\n\t"
+			".popsection\n\t"
+			:
+			: [rseq_cs] "m"(rs->rseq_cs), [cpu_id] "m"(rs->cpu_id), [cpus] "r"(cpus_),
+			  [stride] "r"(stride), [delta] "r"(delta), [field] "r"(field)
+			: "memory", "cc", "rax"
+			: restart, unavailable);
+		return true;
+	unavailable:
+		return false;
+	}
+#endif
+
+public:
+	using value_type = T;
+
+	// slots are value-initialized, so counters of a trivial T start at zero,
+	// with args each object is then assigned T(args...)
+	template<typename... Args>
+	percpu_protected(const Args&... args) : cpus_(configured_cpus()), slots_(new slot[cpus_]())
+	{
+		if constexpr (sizeof...(Args) != 0)
+			for (std::uint32_t i = 0; i < cpus_; ++i)
+				slots_[i].object = T(args...);
+	}
+
+	// cpu_count()
+	// 
+	// Returns the number of slots
+	std::uint32_t cpu_count() const
+	{
+		return cpus_;
+	}
+
+	// add(member, delta)
+	// 
+	// Adds delta to the member of the current CPU slot without lock.
+	// The rseq fast path only covers 64-bit integral members, narrower
+	// integral and floating point members use the relaxed atomic add
+	template<typename F>
+	requires std::integral<F> || std::floating_point<F>
+	void add(F T::* member, F delta)
+	{
+		slot& first = slots_[0];
+		auto* field = reinterpret_cast<std::byte*>(&(first.object.*member));
+#if PERCPU_RSEQ
+		if constexpr (std::integral<F> && sizeof(F) == sizeof(std::uint64_t))
+			if (rseq_add(field, static_cast<std::uint64_t>(delta)))
+				return;
+#endif
+		(void)field;
+		std::atomic_ref(slots_[current_cpu()].object.*member).fetch_add(delta, std::memory_order_relaxed);
+	}
+
+	// get_local()
+	// 
+	// Returns a unique_guard for the object of the current CPU slot
+	unique_guard<T, spin_lock> get_local()
+	{
+		slot& s = slots_[current_cpu()];
+		return unique_guard<T, spin_lock>(s.lock, s.object);
+	}
+
+	// write(f)
+	// 
+	// Calls f with the object of the current CPU slot while its lock is
+	// held and returns the result of f by value
+	template<typename F>
+	auto write(F&& f)
+	{
+		slot& s = slots_[current_cpu()];
+		std::lock_guard lk(s.lock);
+		return std::invoke(std::forward<F>(f), s.object);
+	}
+
+	// sum(member)
+	// 
+	// Returns the sum of the member over all CPU slots
+	template<typename F>
+	requires std::integral<F> || std::floating_point<F>
+	F sum(F T::* member) const
+	{
+		F total{};
+		for (std::uint32_t i = 0; i < cpus_; ++i)
+			total += std::atomic_ref(const_cast<F&>(slots_[i].object.*member)).load(std::memory_order_relaxed);
+		return total;
+	}
+
+	// read(init, fold)
+	// 
+	// Folds the objects of all CPU slots into init with
+	// init = fold(std::move(init), object) and returns the result
+	template<typename R, typename F>
+	R read(R init, F&& fold) const
+	{
+		for (std::uint32_t i = 0; i < cpus_; ++i)
+		{
+			slot& s = slots_[i];
+			std::lock_guard lk(s.lock);
+			init = std::invoke(fold, std::move(init), static_cast<const T&>(s.object));
+		}
+		return init;
+	}
+};
+#endif
@@ -0,0 +1,87 @@
+#ifndef PI_MUTEX
+#define PI_MUTEX
+
+#if defined(__linux__)
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <system_error>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "protected_data.h"
+
+// pi_mutex
+// 
+// Priority inheritance mutex built on the Linux FUTEX_LOCK_PI protocol.
+// The futex word holds the TID of the owner, so when a thread has to wait
+// the kernel knows the owner and boosts it to the priority of the highest
+// priority waiter (e.g. a SCHED_FIFO thread waiting on a protected_data
+// held by a SCHED_OTHER background thread) until it unlocks.
+// Uncontended lock and unlock are a single compare-exchange in user space.
+// 
+// Only exclusive locking is possible, the kernel has no PI reader-writer lock.
+// e.g. protected_data<Shape, pi_mutex>
+class pi_mutex
+{
+	// 0 when unlocked, owner TID otherwise, FUTEX_WAITERS is set by the kernel
+	std::atomic<std::uint32_t> word_{ 0 };
+
+	static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t));
+	static_assert(std::atomic<std::uint32_t>::is_always_lock_free);
+
+	pi_mutex(const pi_mutex& other) = delete;
+	pi_mutex& operator=(const pi_mutex& other) = delete;
+
+	static std::uint32_t this_tid()
+	{
+		static thread_local const std::uint32_t tid = static_cast<std::uint32_t>(::syscall(SYS_gettid));
+		return tid;
+	}
+
+	long futex(int op)
+	{
+		return ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word_), op, 0, nullptr, nullptr, 0);
+	}
+
+public:
+	pi_mutex() = default;
+
+	void lock()
+	{
+		std::uint32_t expected = 0;
+		if (word_.compare_exchange_strong(expected, this_tid(), std::memory_order_acquire, std::memory_order_relaxed))
+			return;
+
+		// the kernel sets FUTEX_WAITERS, queues us by priority and boosts the owner
+		while (futex(FUTEX_LOCK_PI_PRIVATE) != 0)
+		{
+			// EAGAIN: the owner is about to exit, EINTR: interrupted by a signal
+			if (errno != EAGAIN && errno != EINTR)
+				throw std::system_error(errno, std::system_category(), "FUTEX_LOCK_PI");
+		}
+	}
+
+	bool try_lock()
+	{
+		std::uint32_t expected = 0;
+		return word_.compare_exchange_strong(expected, this_tid(), std::memory_order_acquire, std::memory_order_relaxed);
+	}
+
+	void unlock()
+	{
+		std::uint32_t expected = this_tid();
+		if (word_.compare_exchange_strong(expected, 0, std::memory_order_release, std::memory_order_relaxed))
+			return;
+
+		// FUTEX_WAITERS is set, the kernel hands the lock to the top waiter
+		// and drops the priority boost of this thread
+		futex(FUTEX_UNLOCK_PI_PRIVATE);
+	}
+};
+
+#endif
+#endif
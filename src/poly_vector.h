@@ -0,0 +1,262 @@
+#ifndef POLY_VECTOR
+#define POLY_VECTOR
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <map>
+#include <vector>
+#include <bit>
+
+#include "protected_data.h"
+
+// poly_vector<Base, M, Policies...>
+// 
+// Base : common base type of the stored objects
+// M : mutex type
+// Policies : policies of the stored protected_data
+// 
+// Stores heterogeneous protected_data<Derived, M> objects inline in
+// contiguous segments instead of one heap allocation per object.
+// Objects are grouped into power of two size classes (64, 128, 256... bytes),
+// each size class owns a list of fixed size segments and reuses the slots
+// of erased objects. Segments are never moved or freed before the container
+// is destroyed, so the returned protected_handle<Base, lock_type> stays valid
+// until the object is erased.
+template<typename Base, typename M, typename... Policies>
+requires Lockable<M>
+class poly_vector
+{
+public:
+	using lock_type = protected_lock_t<M, Policies...>;
+	using handle_type = protected_handle<Base, lock_type>;
+
+private:
+
+	static constexpr std::size_t segment_alignment = 64;
+	static constexpr std::size_t segment_bytes = 16 * 1024;
+	static constexpr std::size_t min_slot_size = 64;
+
+	// slot_header
+	// 
+	// Placed at the beginning of every slot, the protected_data follows it
+	// in the same cache line
+	struct slot_header
+	{
+		void (*destroy)(slot_header*);
+		handle_type handle;
+		bool live;
+	};
+
+	struct size_class
+	{
+		std::size_t slot_size = 0;
+		std::size_t slots_per_segment = 0;
+		std::size_t used_in_last = 0;
+		std::vector<std::byte*> segments;
+		std::vector<slot_header*> free_slots;
+	};
+
+	struct segment_info
+	{
+		std::byte* end;
+		std::size_t slot_size;
+	};
+
+	std::vector<size_class> classes_;
+	// segment begin -> segment end and slot size, used to find the slot of a handle
+	std::map<std::byte*, segment_info, std::greater<>> segment_index_;
+	std::size_t size_ = 0;
+
+	poly_vector(const poly_vector& other) = delete;
+	poly_vector& operator=(const poly_vector& other) = delete;
+
+	template<typename PD>
+	static constexpr std::size_t payload_offset()
+	{
+		return (sizeof(slot_header) + alignof(PD) - 1) / alignof(PD) * alignof(PD);
+	}
+
+	size_class& class_for(std::size_t bytes)
+	{
+		std::size_t slot_size = std::bit_ceil(bytes < min_slot_size ? min_slot_size : bytes);
+		std::size_t index = std::countr_zero(slot_size) - std::countr_zero(min_slot_size);
+		if (classes_.size() <= index)
+			classes_.resize(index + 1);
+
+		size_class& sc = classes_[index];
+		if (sc.slot_size == 0)
+		{
+			sc.slot_size = slot_size;
+			sc.slots_per_segment = slot_size < segment_bytes ? segment_bytes / slot_size : 1;
+			sc.used_in_last = sc.slots_per_segment;
+		}
+		return sc;
+	}
+
+	slot_header* allocate_slot(size_class& sc)
+	{
+		if (!sc.free_slots.empty())
+		{
+			slot_header* slot = sc.free_slots.back();
+			sc.free_slots.pop_back();
+			return slot;
+		}
+
+		if (sc.used_in_last == sc.slots_per_segment)
+		{
+			std::size_t bytes = sc.slot_size * sc.slots_per_segment;
+			auto* segment = static_cast<std::byte*>(::operator new(bytes, std::align_val_t(segment_alignment)));
+			sc.segments.push_back(segment);
+			segment_index_.emplace(segment, segment_info{ segment + bytes, sc.slot_size });
+			sc.used_in_last = 0;
+		}
+
+		std::byte* slot = sc.segments.back() + sc.slot_size * sc.used_in_last++;
+		return ::new (slot) slot_header{ nullptr, {}, false };
+	}
+
+	// slot header and unused bytes of the slot of a PD count as container
+	// overhead of its footprint group
+	template<typename PD>
+	static void account_slot(std::int64_t sign)
+	{
+		if constexpr (PD::footprint_policy::enabled)
+		{
+			constexpr std::size_t needed = payload_offset<PD>() + sizeof(PD);
+			constexpr std::size_t slot_size = std::bit_ceil(needed < min_slot_size ? min_slot_size : needed);
+			PD::footprint_policy::template counters<PD>().container_bytes.fetch_add(sign * std::int64_t(slot_size - sizeof(PD)), std::memory_order_relaxed);
+		}
+	}
+
+	slot_header* slot_of(const handle_type& handle) const
+	{
+		auto* address = reinterpret_cast<std::byte*>(handle.mutex());
+		auto it = segment_index_.lower_bound(address);
+		if (it == segment_index_.end() || address >= it->second.end)
+			return nullptr;
+
+		std::size_t offset = (address - it->first) / it->second.slot_size * it->second.slot_size;
+		return std::launder(reinterpret_cast<slot_header*>(it->first + offset));
+	}
+
+public:
+	poly_vector() = default;
+
+	~poly_vector()
+	{
+		clear();
+		for (auto& sc : classes_)
+			for (std::byte* segment : sc.segments)
+				::operator delete(segment, std::align_val_t(segment_alignment));
+	}
+
+	// emplace<Derived>()
+	// 
+	// Constructs a protected_data<Derived, M, Policies...> in the slot of its
+	// size class and returns a handle viewing it as Base
+	template<typename Derived, typename... Args>
+	requires std::convertible_to<Derived*, Base*>
+	handle_type emplace(Args&&... args)
+	{
+		using pd_type = protected_data<Derived, M, Policies...>;
+		static_assert(alignof(pd_type) <= segment_alignment, "over-aligned types are not supported by poly_vector");
+
+		constexpr std::size_t offset = payload_offset<pd_type>();
+		size_class& sc = class_for(offset + sizeof(pd_type));
+		slot_header* slot = allocate_slot(sc);
+
+		pd_type* pd;
+		try
+		{
+			pd = ::new (reinterpret_cast<std::byte*>(slot) + offset) pd_type(std::forward<Args>(args)...);
+		}
+		catch (...)
+		{
+			sc.free_slots.push_back(slot);
+			throw;
+		}
+
+		slot->destroy = [](slot_header* s) {
+			std::launder(reinterpret_cast<pd_type*>(reinterpret_cast<std::byte*>(s) + offset))->~pd_type();
+			account_slot<pd_type>(-1);
+		};
+		slot->handle = handle_type(*pd);
+		slot->live = true;
+		++size_;
+		account_slot<pd_type>(1);
+		return slot->handle;
+	}
+
+	// erase()
+	// 
+	// Destroys the object referenced by handle and makes its slot reusable.
+	// The caller must make sure no guard of the object is alive.
+	void erase(const handle_type& handle)
+	{
+		slot_header* slot = slot_of(handle);
+		if (!slot || !slot->live)
+			return;
+
+		slot->destroy(slot);
+		slot->live = false;
+		--size_;
+
+		std::size_t slot_size = segment_index_.lower_bound(reinterpret_cast<std::byte*>(slot))->second.slot_size;
+		classes_[std::countr_zero(slot_size) - std::countr_zero(min_slot_size)].free_slots.push_back(slot);
+	}
+
+	// clear()
+	// 
+	// Destroys all objects, keeps the segments for reuse
+	void clear()
+	{
+		for (auto& sc : classes_)
+		{
+			sc.free_slots.clear();
+			for (std::size_t s = 0; s < sc.segments.size(); ++s)
+			{
+				std::size_t used = s + 1 == sc.segments.size() ? sc.used_in_last : sc.slots_per_segment;
+				for (std::size_t i = 0; i < used; ++i)
+				{
+					auto* slot = std::launder(reinterpret_cast<slot_header*>(sc.segments[s] + i * sc.slot_size));
+					if (slot->live)
+					{
+						slot->destroy(slot);
+						slot->live = false;
+					}
+					sc.free_slots.push_back(slot);
+				}
+			}
+		}
+		size_ = 0;
+	}
+
+	std::size_t size() const
+	{
+		return size_;
+	}
+
+	// for_each()
+	// 
+	// Calls f with the handle of every live object. Objects are visited
+	// segment by segment in memory order, grouped by size class.
+	template<typename F>
+	void for_each(F&& f) const
+	{
+		for (const auto& sc : classes_)
+		{
+			for (std::size_t s = 0; s < sc.segments.size(); ++s)
+			{
+				std::size_t used = s + 1 == sc.segments.size() ? sc.used_in_last : sc.slots_per_segment;
+				for (std::size_t i = 0; i < used; ++i)
+				{
+					auto* slot = std::launder(reinterpret_cast<const slot_header*>(sc.segments[s] + i * sc.slot_size));
+					if (slot->live)
+						f(slot->handle);
+				}
+			}
+		}
+	}
+};
+#endif
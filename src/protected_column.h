@@ -0,0 +1,644 @@
+#ifndef PROTECTED_COLUMN
+#define PROTECTED_COLUMN
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <shared_mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+#include "protected_data.h"
+
+// ----- Column kernels
+// 
+// Reductions over contiguous numeric storage. scalar_column_kernels<T> is
+// the portable implementation, column_kernels<T> uses AVX-512 or AVX2 for
+// int32_t, float and double when the translation unit is compiled for them
+// (e.g. -mavx2, -march=native) and the scalar code for the tail and every
+// other type.
+
+// column_sum_t<T>
+// 
+// Accumulator type of sum(), sums of int columns don't overflow and sums of
+// float columns don't lose the small values
+template<typename T>
+using column_sum_t = std::conditional_t<std::is_floating_point_v<T>, double,
+	std::conditional_t<std::is_signed_v<T>, std::int64_t, std::uint64_t>>;
+
+// in_range<T>
+// 
+// Predicate lo <= value < hi, count_if() runs it with the vectorized kernel
+template<typename T>
+struct in_range
+{
+	T lo;
+	T hi;
+
+	bool operator()(T value) const { return lo <= value && value < hi; }
+};
+
+// histogram_bins
+// 
+// bins equal width bins over [lo, hi), index() returns bins for values outside
+struct histogram_bins
+{
+	double lo;
+	double hi;
+	std::size_t bins;
+
+	double scale() const { return bins / (hi - lo); }
+
+	std::size_t index(double value) const
+	{
+		if (!(lo <= value && value < hi))
+			return bins;
+		return static_cast<std::size_t>(std::min((value - lo) * scale(), double(bins - 1)));
+	}
+};
+
+// scalar_column_kernels<T>
+// 
+// min() and max() require n > 0, histogram() counts have bins + 1 entries,
+// the last one collects the values out of range
+template<typename T>
+struct scalar_column_kernels
+{
+	static_assert(std::is_arithmetic_v<T>);
+
+	static column_sum_t<T> sum(const T* data, std::size_t n)
+	{
+		column_sum_t<T> s = 0;
+		for (std::size_t i = 0; i < n; i++)
+			s += data[i];
+		return s;
+	}
+
+	static T min(const T* data, std::size_t n)
+	{
+		return *std::min_element(data, data + n);
+	}
+
+	static T max(const T* data, std::size_t n)
+	{
+		return *std::max_element(data, data + n);
+	}
+
+	template<typename F>
+	static std::size_t count_if(const T* data, std::size_t n, const F& pred)
+	{
+		std::size_t c = 0;
+		for (std::size_t i = 0; i < n; i++)
+			c += pred(data[i]) ? 1 : 0;
+		return c;
+	}
+
+	static void histogram(const T* data, std::size_t n, const histogram_bins& h, std::size_t* counts)
+	{
+		for (std::size_t i = 0; i < n; i++)
+			counts[h.index(static_cast<double>(data[i]))]++;
+	}
+};
+
+// simd_lanes<T>
+// 
+// Vector operations of the target instruction set for element type T,
+// specialized below for the supported types
+template<typename T>
+struct simd_lanes
+{
+	static constexpr bool supported = false;
+};
+
+#if defined(__AVX512F__)
+
+struct simd_lanes_pd
+{
+	// bin indices of 8 doubles, h.bins for values outside the range
+	static void bins(__m512d x, const histogram_bins& h, std::int32_t* out)
+	{
+		__m512d lo = _mm512_set1_pd(h.lo);
+		__mmask8 in = _mm512_cmp_pd_mask(x, lo, _CMP_GE_OQ) & _mm512_cmp_pd_mask(x, _mm512_set1_pd(h.hi), _CMP_LT_OQ);
+		__m512d scaled = _mm512_min_pd(_mm512_mul_pd(_mm512_sub_pd(x, lo), _mm512_set1_pd(h.scale())), _mm512_set1_pd(double(h.bins - 1)));
+		__m512d index = _mm512_mask_blend_pd(in, _mm512_set1_pd(double(h.bins)), scaled);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm512_cvttpd_epi32(index));
+	}
+};
+
+template<>
+struct simd_lanes<std::int32_t> : simd_lanes_pd
+{
+	static constexpr bool supported = true;
+	static constexpr std::size_t lanes = 16;
+	using vec = __m512i;
+	using wide = __m512i;
+
+	static vec load(const std::int32_t* p) { return _mm512_loadu_si512(p); }
+	static vec min(vec a, vec b) { return _mm512_min_epi32(a, b); }
+	static vec max(vec a, vec b) { return _mm512_max_epi32(a, b); }
+	static std::int32_t reduce_min(vec v) { return _mm512_reduce_min_epi32(v); }
+	static std::int32_t reduce_max(vec v) { return _mm512_reduce_max_epi32(v); }
+
+	static wide wide_zero() { return _mm512_setzero_si512(); }
+	static wide add(wide acc, vec v)
+	{
+		acc = _mm512_add_epi64(acc, _mm512_cvtepi32_epi64(_mm512_castsi512_si256(v)));
+		return _mm512_add_epi64(acc, _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(v, 1)));
+	}
+	static std::int64_t reduce_sum(wide acc) { return _mm512_reduce_add_epi64(acc); }
+
+	static unsigned int count(vec v, const in_range<std::int32_t>& r)
+	{
+		return std::popcount(static_cast<unsigned int>(
+			_mm512_cmpge_epi32_mask(v, _mm512_set1_epi32(r.lo)) & _mm512_cmplt_epi32_mask(v, _mm512_set1_epi32(r.hi))));
+	}
+
+	static void bins(vec v, const histogram_bins& h, std::int32_t* out)
+	{
+		simd_lanes_pd::bins(_mm512_cvtepi32_pd(_mm512_castsi512_si256(v)), h, out);
+		simd_lanes_pd::bins(_mm512_cvtepi32_pd(_mm512_extracti64x4_epi64(v, 1)), h, out + 8);
+	}
+};
+
+template<>
+struct simd_lanes<float> : simd_lanes_pd
+{
+	static constexpr bool supported = true;
+	static constexpr std::size_t lanes = 16;
+	using vec = __m512;
+	using wide = __m512d;
+
+	static vec load(const float* p) { return _mm512_loadu_ps(p); }
+	static vec min(vec a, vec b) { return _mm512_min_ps(a, b); }
+	static vec max(vec a, vec b) { return _mm512_max_ps(a, b); }
+	static float reduce_min(vec v) { return _mm512_reduce_min_ps(v); }
+	static float reduce_max(vec v) { return _mm512_reduce_max_ps(v); }
+
+	static __m512d low(vec v) { return _mm512_cvtps_pd(_mm512_castps512_ps256(v)); }
+	static __m512d high(vec v) { return _mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v), 1))); }
+
+	static wide wide_zero() { return _mm512_setzero_pd(); }
+	static wide add(wide acc, vec v) { return _mm512_add_pd(_mm512_add_pd(acc, low(v)), high(v)); }
+	static double reduce_sum(wide acc) { return _mm512_reduce_add_pd(acc); }
+
+	static unsigned int count(vec v, const in_range<float>& r)
+	{
+		return std::popcount(static_cast<unsigned int>(
+			_mm512_cmp_ps_mask(v, _mm512_set1_ps(r.lo), _CMP_GE_OQ) & _mm512_cmp_ps_mask(v, _mm512_set1_ps(r.hi), _CMP_LT_OQ)));
+	}
+
+	static void bins(vec v, const histogram_bins& h, std::int32_t* out)
+	{
+		simd_lanes_pd::bins(low(v), h, out);
+		simd_lanes_pd::bins(high(v), h, out + 8);
+	}
+};
+
+template<>
+struct simd_lanes<double> : simd_lanes_pd
+{
+	static constexpr bool supported = true;
+	static constexpr std::size_t lanes = 8;
+	using vec = __m512d;
+	using wide = __m512d;
+
+	static vec load(const double* p) { return _mm512_loadu_pd(p); }
+	static vec min(vec a, vec b) { return _mm512_min_pd(a, b); }
+	static vec max(vec a, vec b) { return _mm512_max_pd(a, b); }
+	static double reduce_min(vec v) { return _mm512_reduce_min_pd(v); }
+	static double reduce_max(vec v) { return _mm512_reduce_max_pd(v); }
+
+	static wide wide_zero() { return _mm512_setzero_pd(); }
+	static wide add(wide acc, vec v) { return _mm512_add_pd(acc, v); }
+	static double reduce_sum(wide acc) { return _mm512_reduce_add_pd(acc); }
+
+	static unsigned int count(vec v, const in_range<double>& r)
+	{
+		return std::popcount(static_cast<unsigned int>(
+			_mm512_cmp_pd_mask(v, _mm512_set1_pd(r.lo), _CMP_GE_OQ) & _mm512_cmp_pd_mask(v, _mm512_set1_pd(r.hi), _CMP_LT_OQ)));
+	}
+
+	static void bins(vec v, const histogram_bins& h, std::int32_t* out)
+	{
+		simd_lanes_pd::bins(v, h, out);
+	}
+};
+
+#elif defined(__AVX2__)
+
+struct simd_lanes_pd
+{
+	// bin indices of 4 doubles, h.bins for values outside the range
+	static void bins(__m256d x, const histogram_bins& h, std::int32_t* out)
+	{
+		__m256d lo = _mm256_set1_pd(h.lo);
+		__m256d in = _mm256_and_pd(_mm256_cmp_pd(x, lo, _CMP_GE_OQ), _mm256_cmp_pd(x, _mm256_set1_pd(h.hi), _CMP_LT_OQ));
+		__m256d scaled = _mm256_min_pd(_mm256_mul_pd(_mm256_sub_pd(x, lo), _mm256_set1_pd(h.scale())), _mm256_set1_pd(double(h.bins - 1)));
+		__m256d index = _mm256_blendv_pd(_mm256_set1_pd(double(h.bins)), scaled, in);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm256_cvttpd_epi32(index));
+	}
+
+	// popcount of the sign bits of the 32 bit lanes
+	static unsigned int count_mask(__m256 mask)
+	{
+		return std::popcount(static_cast<unsigned int>(_mm256_movemask_ps(mask)));
+	}
+};
+
+template<>
+struct simd_lanes<std::int32_t> : simd_lanes_pd
+{
+	static constexpr bool supported = true;
+	static constexpr std::size_t lanes = 8;
+	using vec = __m256i;
+	using wide = __m256i;
+
+	static vec load(const std::int32_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+	static vec min(vec a, vec b) { return _mm256_min_epi32(a, b); }
+	static vec max(vec a, vec b) { return _mm256_max_epi32(a, b); }
+
+	static std::int32_t reduce_min(vec v)
+	{
+		alignas(32) std::int32_t a[lanes];
+		_mm256_store_si256(reinterpret_cast<__m256i*>(a), v);
+		return *std::min_element(a, a + lanes);
+	}
+
+	static std::int32_t reduce_max(vec v)
+	{
+		alignas(32) std::int32_t a[lanes];
+		_mm256_store_si256(reinterpret_cast<__m256i*>(a), v);
+		return *std::max_element(a, a + lanes);
+	}
+
+	static wide wide_zero() { return _mm256_setzero_si256(); }
+	static wide add(wide acc, vec v)
+	{
+		acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)));
+		return _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)));
+	}
+
+	static std::int64_t reduce_sum(wide acc)
+	{
+		alignas(32) std::int64_t a[4];
+		_mm256_store_si256(reinterpret_cast<__m256i*>(a), acc);
+		return a[0] + a[1] + a[2] + a[3];
+	}
+
+	static unsigned int count(vec v, const in_range<std::int32_t>& r)
+	{
+		// lo <= v && v < hi is !(lo > v) && hi > v
+		__m256i below = _mm256_cmpgt_epi32(_mm256_set1_epi32(r.lo), v);
+		__m256i under_hi = _mm256_cmpgt_epi32(_mm256_set1_epi32(r.hi), v);
+		return count_mask(_mm256_castsi256_ps(_mm256_andnot_si256(below, under_hi)));
+	}
+
+	static void bins(vec v, const histogram_bins& h, std::int32_t* out)
+	{
+		simd_lanes_pd::bins(_mm256_cvtepi32_pd(_mm256_castsi256_si128(v)), h, out);
+		simd_lanes_pd::bins(_mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1)), h, out + 4);
+	}
+};
+
+template<>
+struct simd_lanes<float> : simd_lanes_pd
+{
+	static constexpr bool supported = true;
+	static constexpr std::size_t lanes = 8;
+	using vec = __m256;
+	using wide = __m256d;
+
+	static vec load(const float* p) { return _mm256_loadu_ps(p); }
+	static vec min(vec a, vec b) { return _mm256_min_ps(a, b); }
+	static vec max(vec a, vec b) { return _mm256_max_ps(a, b); }
+
+	static float reduce_min(vec v)
+	{
+		alignas(32) float a[lanes];
+		_mm256_store_ps(a, v);
+		return *std::min_element(a, a + lanes);
+	}
+
+	static float reduce_max(vec v)
+	{
+		alignas(32) float a[lanes];
+		_mm256_store_ps(a, v);
+		return *std::max_element(a, a + lanes);
+	}
+
+	static __m256d low(vec v) { return _mm256_cvtps_pd(_mm256_castps256_ps128(v)); }
+	static __m256d high(vec v) { return _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)); }
+
+	static wide wide_zero() { return _mm256_setzero_pd(); }
+	static wide add(wide acc, vec v) { return _mm256_add_pd(_mm256_add_pd(acc, low(v)), high(v)); }
+
+	static double reduce_sum(wide acc)
+	{
+		alignas(32) double a[4];
+		_mm256_store_pd(a, acc);
+		return a[0] + a[1] + a[2] + a[3];
+	}
+
+	static unsigned int count(vec v, const in_range<float>& r)
+	{
+		return count_mask(_mm256_and_ps(_mm256_cmp_ps(v, _mm256_set1_ps(r.lo), _CMP_GE_OQ), _mm256_cmp_ps(v, _mm256_set1_ps(r.hi), _CMP_LT_OQ)));
+	}
+
+	static void bins(vec v, const histogram_bins& h, std::int32_t* out)
+	{
+		simd_lanes_pd::bins(low(v), h, out);
+		simd_lanes_pd::bins(high(v), h, out + 4);
+	}
+};
+
+template<>
+struct simd_lanes<double> : simd_lanes_pd
+{
+	static constexpr bool supported = true;
+	static constexpr std::size_t lanes = 4;
+	using vec = __m256d;
+	using wide = __m256d;
+
+	static vec load(const double* p) { return _mm256_loadu_pd(p); }
+	static vec min(vec a, vec b) { return _mm256_min_pd(a, b); }
+	static vec max(vec a, vec b) { return _mm256_max_pd(a, b); }
+
+	static double reduce_min(vec v)
+	{
+		alignas(32) double a[lanes];
+		_mm256_store_pd(a, v);
+		return *std::min_element(a, a + lanes);
+	}
+
+	static double reduce_max(vec v)
+	{
+		alignas(32) double a[lanes];
+		_mm256_store_pd(a, v);
+		return *std::max_element(a, a + lanes);
+	}
+
+	static wide wide_zero() { return _mm256_setzero_pd(); }
+	static wide add(wide acc, vec v) { return _mm256_add_pd(acc, v); }
+
+	static double reduce_sum(wide acc)
+	{
+		alignas(32) double a[4];
+		_mm256_store_pd(a, acc);
+		return a[0] + a[1] + a[2] + a[3];
+	}
+
+	static unsigned int count(vec v, const in_range<double>& r)
+	{
+		__m256d in = _mm256_and_pd(_mm256_cmp_pd(v, _mm256_set1_pd(r.lo), _CMP_GE_OQ), _mm256_cmp_pd(v, _mm256_set1_pd(r.hi), _CMP_LT_OQ));
+		return std::popcount(static_cast<unsigned int>(_mm256_movemask_pd(in)));
+	}
+
+	static void bins(vec v, const histogram_bins& h, std::int32_t* out)
+	{
+		simd_lanes_pd::bins(v, h, out);
+	}
+};
+
+#endif
+
+// column_kernels<T>
+// 
+// Vectorized kernels where simd_lanes<T> is supported, the scalar ones otherwise.
+// Floating point min() and max() are unspecified if the column contains NaNs.
+template<typename T>
+struct column_kernels : scalar_column_kernels<T>
+{
+	using scalar = scalar_column_kernels<T>;
+	using lanes = simd_lanes<T>;
+
+	static column_sum_t<T> sum(const T* data, std::size_t n)
+	{
+		if constexpr (!lanes::supported)
+			return scalar::sum(data, n);
+		else
+		{
+			// two accumulators hide the latency of the adds
+			auto acc0 = lanes::wide_zero(), acc1 = lanes::wide_zero();
+			std::size_t i = 0;
+			for (; i + 2 * lanes::lanes <= n; i += 2 * lanes::lanes)
+			{
+				acc0 = lanes::add(acc0, lanes::load(data + i));
+				acc1 = lanes::add(acc1, lanes::load(data + i + lanes::lanes));
+			}
+			for (; i + lanes::lanes <= n; i += lanes::lanes)
+				acc0 = lanes::add(acc0, lanes::load(data + i));
+			return lanes::reduce_sum(acc0) + lanes::reduce_sum(acc1) + scalar::sum(data + i, n - i);
+		}
+	}
+
+	static T min(const T* data, std::size_t n)
+	{
+		if constexpr (!lanes::supported)
+			return scalar::min(data, n);
+		else
+		{
+			if (n < lanes::lanes)
+				return scalar::min(data, n);
+			auto m = lanes::load(data);
+			for (std::size_t i = lanes::lanes; i + lanes::lanes <= n; i += lanes::lanes)
+				m = lanes::min(m, lanes::load(data + i));
+			// the last vector overlaps the tail, repeated elements don't change the result
+			return lanes::reduce_min(lanes::min(m, lanes::load(data + n - lanes::lanes)));
+		}
+	}
+
+	static T max(const T* data, std::size_t n)
+	{
+		if constexpr (!lanes::supported)
+			return scalar::max(data, n);
+		else
+		{
+			if (n < lanes::lanes)
+				return scalar::max(data, n);
+			auto m = lanes::load(data);
+			for (std::size_t i = lanes::lanes; i + lanes::lanes <= n; i += lanes::lanes)
+				m = lanes::max(m, lanes::load(data + i));
+			return lanes::reduce_max(lanes::max(m, lanes::load(data + n - lanes::lanes)));
+		}
+	}
+
+	using scalar::count_if;
+
+	static std::size_t count_if(const T* data, std::size_t n, const in_range<T>& r)
+	{
+		if constexpr (!lanes::supported)
+			return scalar::count_if(data, n, r);
+		else
+		{
+			std::size_t c = 0, i = 0;
+			for (; i + lanes::lanes <= n; i += lanes::lanes)
+				c += lanes::count(lanes::load(data + i), r);
+			return c + scalar::count_if(data + i, n - i, r);
+		}
+	}
+
+	static void histogram(const T* data, std::size_t n, const histogram_bins& h, std::size_t* counts)
+	{
+		if constexpr (!lanes::supported)
+			return scalar::histogram(data, n, h, counts);
+		else
+		{
+			// bin indices are computed with vectors, the increments go to
+			// alternating copies of the counts so repeated bins don't serialize
+			std::vector<std::size_t> copy(h.bins + 1);
+			std::int32_t index[lanes::lanes];
+			std::size_t i = 0;
+			for (; i + lanes::lanes <= n; i += lanes::lanes)
+			{
+				lanes::bins(lanes::load(data + i), h, index);
+				for (std::size_t j = 0; j < lanes::lanes; j += 2)
+				{
+					counts[index[j]]++;
+					copy[index[j + 1]]++;
+				}
+			}
+			for (std::size_t b = 0; b <= h.bins; b++)
+				counts[b] += copy[b];
+			scalar::histogram(data + i, n - i, h, counts);
+		}
+	}
+};
+
+// ----- Protected columns
+
+// column_view<T>
+// 
+// Read only view of a column, passed to the callback of protected_column::read()
+// to run several kernels under the same acquisition
+template<typename T>
+class column_view
+{
+	const T* data_;
+	std::size_t size_;
+
+public:
+	column_view(const T* data, std::size_t size) : data_(data), size_(size) {}
+
+	const T* data() const { return data_; }
+	std::size_t size() const { return size_; }
+	bool empty() const { return size_ == 0; }
+	const T& operator[](std::size_t i) const { return data_[i]; }
+
+	column_sum_t<T> sum() const { return column_kernels<T>::sum(data_, size_); }
+
+	std::optional<T> min() const
+	{
+		if (empty())
+			return std::nullopt;
+		return column_kernels<T>::min(data_, size_);
+	}
+
+	std::optional<T> max() const
+	{
+		if (empty())
+			return std::nullopt;
+		return column_kernels<T>::max(data_, size_);
+	}
+
+	// count_if()
+	// 
+	// Vectorized for in_range<T>, any other predicate is called per element
+	template<typename F>
+	std::size_t count_if(const F& pred) const
+	{
+		return column_kernels<T>::count_if(data_, size_, pred);
+	}
+
+	// histogram()
+	// 
+	// Counts the values of every one of bins equal width bins over [lo, hi),
+	// values outside the range are not counted
+	std::vector<std::size_t> histogram(double lo, double hi, std::size_t bins) const
+	{
+		std::vector<std::size_t> counts(bins + 1);
+		if (bins != 0 && lo < hi)
+			column_kernels<T>::histogram(data_, size_, histogram_bins{ lo, hi, bins }, counts.data());
+		counts.pop_back();
+		return counts;
+	}
+};
+
+// protected_column<T, M, Policies...>
+// 
+// T : arithmetic element type
+// M : mutex type, shared locking is used for the kernels if available
+// 
+// Contiguous numeric storage in a protected_data<std::vector<T>, M, Policies...>
+// with built-in sum, min/max, count_if and histogram. Each kernel runs under
+// a single acquisition, directly on the storage, so aggregations neither copy
+// the values out nor hold the lock through a scalar loop.
+// 
+// e.g.
+// protected_column<int> values;
+// values.get_unique()->push_back(5);
+// auto [sum, max] = values.read([](auto column) { return std::pair(column.sum(), column.max()); });
+template<typename T, typename M = std::shared_mutex, typename... Policies>
+requires std::is_arithmetic_v<T>
+class protected_column
+{
+	protected_data<std::vector<T>, M, Policies...> data_;
+
+public:
+	using value_type = T;
+	using lock_type = protected_lock_t<M, Policies...>;
+
+	template<typename... Args>
+	protected_column(Args&&... args) : data_(std::forward<Args>(args)...) {}
+
+	auto get_unique() { return data_.get_unique(); }
+	auto get_shared() const requires SharedLockable<lock_type> { return data_.get_shared(); }
+
+	// read()
+	// 
+	// Invokes f with a column_view under one acquisition and returns its result
+	template<typename F>
+	auto read(F&& f) const
+	{
+		return data_.read([&](const std::vector<T>& values) {
+			return std::invoke(std::forward<F>(f), column_view<T>(values.data(), values.size()));
+			});
+	}
+
+	// write()
+	// 
+	// Invokes f with the underlying vector under the exclusive lock
+	template<typename F>
+	auto write(F&& f)
+	{
+		return data_.write(std::forward<F>(f));
+	}
+
+	std::size_t size() const { return read([](column_view<T> c) { return c.size(); }); }
+	column_sum_t<T> sum() const { return read([](column_view<T> c) { return c.sum(); }); }
+	std::optional<T> min() const { return read([](column_view<T> c) { return c.min(); }); }
+	std::optional<T> max() const { return read([](column_view<T> c) { return c.max(); }); }
+
+	template<typename F>
+	std::size_t count_if(const F& pred) const
+	{
+		return read([&](column_view<T> c) { return c.count_if(pred); });
+	}
+
+	std::vector<std::size_t> histogram(double lo, double hi, std::size_t bins) const
+	{
+		return read([&](column_view<T> c) { return c.histogram(lo, hi, bins); });
+	}
+
+	lock_stats stats() const requires requires(const lock_type& l) { l.stats(); }
+	{
+		return data_.stats();
+	}
+};
+#endif
@@ -4,6 +4,14 @@
 #include <optional>
 #include <memory>
 #include <concepts>
+#include <functional>
+#include <utility>
+#include <mutex>
+#include <shared_mutex>
+#include <stop_token>
+#include <cstdint>
+
+#include "protected_data_policies.h"
 
 template <typename M>
 concept Lockable = requires(M mutex) {
@@ -12,17 +20,99 @@ concept Lockable = requires(M mutex) {
 };
 
 template <typename M>
-concept SharedLockable = requires(M mutex) {
-	requires Lockable<M>;
+concept SharedLockable = Lockable<M> && requires(M mutex) {
 	{ mutex.lock_shared() } -> std::same_as<void>;
 	{ mutex.unlock_shared() } -> std::same_as<void>;
 };
 
+// StopLockable mutexes can be waited for interruptibly,
+// lock(stoken) returns false if a stop was requested before the lock was acquired
+template <typename M>
+concept StopLockable = Lockable<M> && requires(M mutex, std::stop_token stoken) {
+	{ mutex.lock(stoken) } -> std::same_as<bool>;
+};
+
+template <typename M>
+concept StopSharedLockable = StopLockable<M> && SharedLockable<M> && requires(M mutex, std::stop_token stoken) {
+	{ mutex.lock_shared(stoken) } -> std::same_as<bool>;
+};
+
+// TransferableLockable mutexes have no owner affinity, they may be unlocked
+// by another thread than the one that locked them (e.g. handoff_mutex)
+template <typename M>
+concept TransferableLockable = Lockable<M> && requires {
+	requires M::transferable;
+};
+
+// FreezableLockable mutexes can make the object immutable, shared acquisitions
+// of a frozen object take no lock and exclusive ones fail (e.g. freezable)
+template <typename M>
+concept FreezableLockable = SharedLockable<M> && requires(M mutex, const M& cmutex) {
+	{ mutex.freeze() } -> std::same_as<void>;
+	{ mutex.thaw() } -> std::same_as<void>;
+	{ cmutex.is_frozen() } -> std::same_as<bool>;
+};
+
+// stale_snapshot<T>
+// 
+// Copy of a protected object published by a StaleReadableLockable mutex,
+// version counts the exclusive unlocks before the copy was taken
+struct stale_snapshot_base
+{
+	std::uint64_t version = 0;
+};
+
+template<typename T>
+struct stale_snapshot : stale_snapshot_base
+{
+	T object;
+
+	stale_snapshot(std::uint64_t v, const T& o) : stale_snapshot_base{ v }, object(o) {};
+};
+
+// StaleReadableLockable mutexes publish a copy of the object at every exclusive
+// unlock, readers that find the lock taken can use it instead of waiting
+// (e.g. stale_readable)
+template <typename M>
+concept StaleReadableLockable = SharedLockable<M> && requires(M mutex, const M& cmutex) {
+	{ mutex.try_lock_shared() } -> std::convertible_to<bool>;
+	{ cmutex.published() } -> std::same_as<std::shared_ptr<const stale_snapshot_base>>;
+};
+
 // forward declaration of protected data class
-template<typename T, typename M>
-requires Lockable<M>
+template<typename T, typename M, typename... Policies>
+requires Lockable<M> && valid_policies<Policies...>
 class protected_data;
 
+// protected_data_access
+// 
+// Gives containers and handles built on top of protected_data access to
+// the mutex and the object without acquiring a guard
+struct protected_data_access;
+
+// bind_protected_region()
+// 
+// Lets mutex types that need the address range of the protected object
+// (e.g. nested_lock) record it when the protected_data is constructed
+template<typename M, typename T>
+void bind_protected_region(M& mutex, const T& object)
+{
+	if constexpr (requires { mutex.bind_region(std::addressof(object), sizeof(T)); })
+		mutex.bind_region(std::addressof(object), sizeof(T));
+}
+
+// bind_protected_object()
+// 
+// Lets mutex types that need the type of the protected object
+// (e.g. stale_readable, which copies it) bind to it when the protected_data
+// is constructed
+template<typename M, typename T>
+void bind_protected_object(M& mutex, const T& object)
+{
+	if constexpr (requires { mutex.bind_object(object); })
+		mutex.bind_object(object);
+}
+
 // unique_guard<T, M>
 // 
 // T : contained object type
@@ -38,16 +128,17 @@ class unique_guard
 	std::unique_lock<M> lock_;
 	T& object_;
 
-	friend class protected_data<T, M>;
-
 	unique_guard();
 
 	unique_guard(const unique_guard& other) = delete;
 	unique_guard& operator=(unique_guard other) = delete;
 
 public:
-	unique_guard(protected_data<T, M>& pd);
+	template<typename... Policies>
+	requires std::same_as<protected_lock_t<M, Policies...>, M>
+	unique_guard(protected_data<T, M, Policies...>& pd);
 	unique_guard(M& mutex, T& object) : lock_(mutex), object_(object) {};
+	unique_guard(M& mutex, T& object, std::adopt_lock_t) : lock_(mutex, std::adopt_lock), object_(object) {};
 
 	T& operator*()
 	{
@@ -75,16 +166,17 @@ class shared_guard
 	std::shared_lock<M> lock_;
 	T const& object_;
 
-	friend class protected_data<T, M>;
-
 	shared_guard();
 
 	shared_guard(const shared_guard& other) = delete;
 	shared_guard& operator=(shared_guard other) = delete;
 
 public:
-	shared_guard(const protected_data<T, M>& pd);
+	template<typename... Policies>
+	requires std::same_as<protected_lock_t<M, Policies...>, M>
+	shared_guard(const protected_data<T, M, Policies...>& pd);
 	shared_guard(M& mutex_, T const& object) : lock_(mutex_), object_(object) {};
+	shared_guard(M& mutex_, T const& object, std::adopt_lock_t) : lock_(mutex_, std::adopt_lock), object_(object) {};
 
 	const T& operator*()
 	{
@@ -97,47 +189,321 @@ public:
 	}
 };
 
-// protected_data<T, M>
+// snapshot_guard<T>
+// 
+// T : contained object type
+// 
+// Returned by backends that hand out validated copies instead of locking
+// (e.g. seqlock_protected, atomic_protected). Holds no lock, the copy stays
+// consistent during its lifetime but may already be outdated.
+// Only the const functions of the object can be called via ->
+template<typename T>
+class snapshot_guard
+{
+	T object_;
+
+public:
+	explicit snapshot_guard(const T& object) : object_(object) {};
+
+	const T& operator*() const
+	{
+		return object_;
+	}
+
+	const T* operator->() const
+	{
+		return &object_;
+	}
+};
+
+// transfer_guard<T, M>
+// 
+// T : contained object type
+// M : TransferableLockable mutex type
+// 
+// Exclusive guard that can be moved to another thread, e.g. into the queue
+// of the next pipeline stage, and released there. Releases the lock when it
+// is destroyed or unlock() is called, whichever comes first.
+// All functions of the object can be called via ->
+template<typename T, typename M>
+	requires TransferableLockable<M>
+class transfer_guard
+{
+	M* mutex_;
+	T* object_;
+
+	transfer_guard(const transfer_guard& other) = delete;
+	transfer_guard& operator=(const transfer_guard& other) = delete;
+
+public:
+	transfer_guard(M& mutex, T& object) : mutex_(&mutex), object_(&object)
+	{
+		mutex_->lock();
+	};
+	transfer_guard(M& mutex, T& object, std::adopt_lock_t) : mutex_(&mutex), object_(&object) {};
+
+	transfer_guard(transfer_guard&& other) noexcept : mutex_(std::exchange(other.mutex_, nullptr)), object_(std::exchange(other.object_, nullptr)) {};
+
+	transfer_guard& operator=(transfer_guard&& other) noexcept
+	{
+		if (this != &other)
+		{
+			unlock();
+			mutex_ = std::exchange(other.mutex_, nullptr);
+			object_ = std::exchange(other.object_, nullptr);
+		}
+		return *this;
+	}
+
+	~transfer_guard()
+	{
+		unlock();
+	}
+
+	// owns_lock()
+	// 
+	// Returns whether the guard still holds the lock, false once it was
+	// moved from or unlocked
+	bool owns_lock() const
+	{
+		return mutex_ != nullptr;
+	}
+
+	// unlock()
+	// 
+	// Releases the lock on the calling thread
+	void unlock()
+	{
+		if (mutex_)
+		{
+			std::exchange(mutex_, nullptr)->unlock();
+			object_ = nullptr;
+		}
+	}
+
+	T& operator*()
+	{
+		return *object_;
+	}
+
+	T* operator->()
+	{
+		return object_;
+	}
+};
+
+// stale_guard<T, M>
+// 
+// T : contained object type
+// M : StaleReadableLockable mutex type
+// 
+// Returned by get_shared_or_stale(). Holds either the shared lock of the
+// object, or the copy published at the last exclusive unlock if a writer
+// held the lock. is_stale() tells the two apart, version() is the number of
+// exclusive unlocks the seen state includes.
+// Only the const functions of the object can be called via ->
+template<typename T, typename M>
+	requires StaleReadableLockable<M>
+class stale_guard
+{
+	std::shared_lock<M> lock_;
+	std::shared_ptr<const stale_snapshot<T>> snapshot_;
+	const T* object_;
+
+	stale_guard(const stale_guard& other) = delete;
+	stale_guard& operator=(stale_guard other) = delete;
+
+public:
+	stale_guard(M& mutex, const T& object, std::adopt_lock_t) : lock_(mutex, std::adopt_lock), object_(&object) {};
+	explicit stale_guard(std::shared_ptr<const stale_snapshot<T>> snapshot) : snapshot_(std::move(snapshot)), object_(&snapshot_->object) {};
+
+	bool is_stale() const
+	{
+		return snapshot_ != nullptr;
+	}
+
+	// version()
+	// 
+	// Under the lock no writer can publish, so the last published version
+	// is the one of the object
+	std::uint64_t version() const
+	{
+		return snapshot_ ? snapshot_->version : lock_.mutex()->published()->version;
+	}
+
+	const T& operator*() const
+	{
+		return *object_;
+	}
+
+	const T* operator->() const
+	{
+		return object_;
+	}
+};
+
+// protected_data<T, M, Policies...>
 // 
 // T : contained object type
 // M : mutex type
+// Policies : optional layout, stats and reclaim policies (see protected_data_policies.h)
 // 
 // Provides RAII style container for thread-safe object handling
-// via returning shared_guard class instances upon
-// get_unique() function call
-template<typename T, typename M>
-requires Lockable<M>
+// via returning unique_guard and shared_guard class instances upon
+// get_unique() and get_shared() function calls.
+// get_shared() is only available if the lock type is SharedLockable.
+// Guards are of type unique_guard<T, lock_type> and shared_guard<T, lock_type>,
+// lock_type is M unless a stats policy wraps it.
+template<typename T, typename M, typename... Policies>
+requires Lockable<M> && valid_policies<Policies...>
 class protected_data
 {
-	M mutex_;
-	T object_;
+public:
+	using value_type = T;
+	using lock_type = protected_lock_t<M, Policies...>;
+	using layout_policy = select_policy_t<layout_policy_tag, default_layout, Policies...>;
+	using reclaim_policy = select_policy_t<reclaim_policy_tag, immediate_reclaim, Policies...>;
+	using footprint_policy = select_policy_t<footprint_policy_tag, no_footprint, Policies...>;
+
+private:
+	static constexpr std::size_t mutex_alignment = layout_policy::mutex_alignment > alignof(lock_type) ? layout_policy::mutex_alignment : alignof(lock_type);
+	static constexpr std::size_t object_alignment = layout_policy::object_alignment > alignof(T) ? layout_policy::object_alignment : alignof(T);
+
+	alignas(mutex_alignment) mutable lock_type mutex_;
+	alignas(object_alignment) T object_;
 
-	friend class unique_guard<T, M>;
+	friend struct protected_data_access;
 
 	protected_data(const protected_data& other) = delete;
 	protected_data& operator=(protected_data other) = delete;
 
+	void account_footprint(std::int64_t sign)
+	{
+		if constexpr (footprint_policy::enabled)
+		{
+			footprint_counters& c = footprint_policy::template counters<protected_data>();
+			c.instances.fetch_add(sign, std::memory_order_relaxed);
+			c.object_bytes.fetch_add(sign * std::int64_t(sizeof(T)), std::memory_order_relaxed);
+			c.mutex_bytes.fetch_add(sign * std::int64_t(sizeof(lock_type)), std::memory_order_relaxed);
+			c.padding_bytes.fetch_add(sign * std::int64_t(sizeof(protected_data) - sizeof(T) - sizeof(lock_type)), std::memory_order_relaxed);
+		}
+	}
+
 public:
 	template<typename... Args>
-	protected_data(Args&&... args) : object_(std::forward<Args>(args)...) {};
+	protected_data(Args&&... args) : object_(std::forward<Args>(args)...)
+	{
+		bind_protected_region(mutex_, object_);
+		bind_protected_object(mutex_, object_);
+		account_footprint(1);
+	};
 
-	protected_data(T&& object) : object_(object) {};
+	protected_data(T&& object) : object_(std::move(object))
+	{
+		bind_protected_region(mutex_, object_);
+		bind_protected_object(mutex_, object_);
+		account_footprint(1);
+	};
 
-	~protected_data() {}
+	~protected_data()
+	{
+		reclaim_policy::before_destroy(mutex_);
+		account_footprint(-1);
+	}
 
 	// get_unique()
 	// 
 	// Acquires the unique_lock of the mutex and returns a unique_guard
-	unique_guard<T, M> get_unique()
+	unique_guard<T, lock_type> get_unique()
+	{
+		return unique_guard<T, lock_type>(mutex_, object_);
+	}
+
+	// get_unique(stoken)
+	// 
+	// Waits for the unique_lock of the mutex until it is acquired or a stop
+	// is requested on stoken, returns an empty optional in the latter case
+	std::optional<unique_guard<T, lock_type>> get_unique(std::stop_token stoken) requires StopLockable<lock_type>
 	{
-		return unique_guard<T, M>(mutex_, object_);
+		if (!mutex_.lock(stoken))
+			return {};
+		return std::optional<unique_guard<T, lock_type>>(std::in_place, mutex_, object_, std::adopt_lock);
+	}
+
+	// get_transferable()
+	// 
+	// Acquires the exclusive lock and returns a movable transfer_guard, which
+	// may be released by another thread than the calling one.
+	// Mutex must be TransferableLockable
+	auto get_transferable() requires TransferableLockable<lock_type>
+	{
+		return transfer_guard<T, lock_type>(mutex_, object_);
 	}
-	
+
 	// get_shared()
 	// 
-	// Acquires the shared_lock of the mutex and returns a shared_guard
+	// Acquires the shared_lock of the mutex and returns a shared_guard<T, lock_type>
 	// Mutex must be SharedLockable
-	//shared_guard<T, M> get_shared() const;
+	auto get_shared() const requires SharedLockable<lock_type>
+	{
+		return shared_guard<T, lock_type>(mutex_, object_);
+	}
+
+	// get_shared(stoken)
+	// 
+	// Waits for the shared_lock of the mutex until it is acquired or a stop
+	// is requested on stoken, returns an empty optional in the latter case
+	auto get_shared(std::stop_token stoken) const requires StopSharedLockable<lock_type>
+	{
+		if (!mutex_.lock_shared(stoken))
+			return std::optional<shared_guard<T, lock_type>>();
+		return std::optional<shared_guard<T, lock_type>>(std::in_place, mutex_, object_, std::adopt_lock);
+	}
+
+	// get_shared_or_stale()
+	// 
+	// Never blocks. Returns a stale_guard that holds the shared lock if it
+	// could be acquired, or the copy published at the last exclusive unlock
+	// otherwise. Mutex must be StaleReadableLockable
+	auto get_shared_or_stale() const requires StaleReadableLockable<lock_type>
+	{
+		if (mutex_.try_lock_shared())
+			return stale_guard<T, lock_type>(mutex_, object_, std::adopt_lock);
+		return stale_guard<T, lock_type>(std::static_pointer_cast<const stale_snapshot<T>>(mutex_.published()));
+	}
+
+	// read(f)
+	// 
+	// Calls f with a const reference of the object under the shared lock,
+	// or under the exclusive lock if the mutex is not SharedLockable,
+	// and returns the result of f by value
+	template<typename F>
+	auto read(F&& f) const
+	{
+		if constexpr (SharedLockable<lock_type>)
+		{
+			std::shared_lock<lock_type> lock(mutex_);
+			return std::invoke(std::forward<F>(f), std::as_const(object_));
+		}
+		else
+		{
+			std::unique_lock<lock_type> lock(mutex_);
+			if constexpr (requires { mutex_.mark_read(); })
+				mutex_.mark_read();
+			return std::invoke(std::forward<F>(f), std::as_const(object_));
+		}
+	}
+
+	// write(f)
+	// 
+	// Calls f with a reference of the object under the exclusive lock
+	// and returns the result of f by value
+	template<typename F>
+	auto write(F&& f)
+	{
+		std::unique_lock<lock_type> lock(mutex_);
+		return std::invoke(std::forward<F>(f), object_);
+	}
 
 	// can_cast_to<U>()
 	// 
@@ -151,62 +517,175 @@ public:
 
 	// get_unique_cast()
 	// 
-	// Tries to dynamically cast the data to type U and returns a 
-	// unique_guard of type U without any lock
+	// Tries to dynamically cast the data to type U and returns a
+	// unique_guard of type U
 	template<typename U>
-	std::optional<unique_guard<U, M>> get_unique_cast()
+	std::optional<unique_guard<U, lock_type>> get_unique_cast()
 	{
 		if (U* ptr = dynamic_cast<U*>(&object_))
-			return std::optional<unique_guard<U, M>>(std::in_place, mutex_, *ptr);
+			return std::optional<unique_guard<U, lock_type>>(std::in_place, mutex_, *ptr);
+		else
+			return {};
+	}
+
+	// get_shared_cast()
+	// 
+	// Tries to dynamically cast the data to type U and returns a
+	// shared_guard of type U
+	template<typename U>
+	std::optional<shared_guard<U, lock_type>> get_shared_cast() const requires SharedLockable<lock_type>
+	{
+		if (const U* ptr = dynamic_cast<const U*>(&object_))
+			return std::optional<shared_guard<U, lock_type>>(std::in_place, mutex_, *ptr);
 		else
 			return {};
 	}
+
+	// freeze()
+	// 
+	// Permanently marks the object read-only until thaw(), later get_shared()
+	// guards take no lock and get_unique() throws std::logic_error.
+	// Mutex must be FreezableLockable
+	void freeze() requires FreezableLockable<lock_type>
+	{
+		mutex_.freeze();
+	}
+
+	// thaw()
+	// 
+	// Waits for all guards of the frozen object to be released and makes it
+	// writable again, a stop-the-world operation.
+	// Mutex must be FreezableLockable
+	void thaw() requires FreezableLockable<lock_type>
+	{
+		mutex_.thaw();
+	}
+
+	bool is_frozen() const requires FreezableLockable<lock_type>
+	{
+		return mutex_.is_frozen();
+	}
+
+	// stats()
+	// 
+	// Returns the statistics collected by the stats policy
+	lock_stats stats() const requires requires(const lock_type& lock) { { lock.stats() } -> std::same_as<lock_stats>; }
+	{
+		return mutex_.stats();
+	}
+};
+
+struct protected_data_access
+{
+	template<typename T, typename M, typename... Policies>
+	static auto& mutex(protected_data<T, M, Policies...>& pd)
+	{
+		return pd.mutex_;
+	}
+
+	template<typename T, typename M, typename... Policies>
+	static auto& mutex(const protected_data<T, M, Policies...>& pd)
+	{
+		return pd.mutex_;
+	}
+
+	template<typename T, typename M, typename... Policies>
+	static T& object(protected_data<T, M, Policies...>& pd)
+	{
+		return pd.object_;
+	}
+
+	template<typename T, typename M, typename... Policies>
+	static const T& object(const protected_data<T, M, Policies...>& pd)
+	{
+		return pd.object_;
+	}
 };
 
-// protected_data<T, M>
+// protected_handle<T, M>
 // 
-// T : contained object type
-// M : shared mutex type
+// T : viewed object type, the stored object type or one of its bases
+// M : lock type of the referenced protected_data
 // 
-// Provides RAII style container for thread-safe object handling
-// via returning unique_guard and shared_guard class instances upon
-// get_unique() and get_shared() function calls
+// Non-owning, copyable reference to a protected_data that is owned by
+// a container. Guards are created directly from the referenced mutex
+// and object, so a handle to protected_data<Derived, M> can be viewed
+// as protected_handle<Base, M> without any cast of the protected_data.
+// The referenced protected_data must outlive the handle.
 template<typename T, typename M>
-requires SharedLockable<M>
-class protected_data<T, M>
+requires Lockable<M>
+class protected_handle
 {
-	mutable M mutex_;
-	T object_;
+	M* mutex_ = nullptr;
+	T* object_ = nullptr;
 
-	friend class unique_guard<T, M>;
-	friend class shared_guard<T, M>;
+public:
+	protected_handle() = default;
 
-	protected_data(const protected_data& other) = delete;
-	protected_data& operator=(protected_data other) = delete;
+	template<typename U, typename N, typename... Policies>
+	requires std::convertible_to<U*, T*> && std::same_as<protected_lock_t<N, Policies...>, M>
+	protected_handle(protected_data<U, N, Policies...>& pd)
+		: mutex_(&protected_data_access::mutex(pd)), object_(&protected_data_access::object(pd)) {};
 
-public:
-	template<typename... Args>
-	protected_data(Args&&... args) : object_(std::forward<Args>(args)...) {};
+	template<typename U>
+	requires std::convertible_to<U*, T*>
+	protected_handle(const protected_handle<U, M>& other)
+		: mutex_(other.mutex()), object_(other.object()) {};
+
+	explicit operator bool() const
+	{
+		return object_ != nullptr;
+	}
 
-	protected_data(T&& object) : object_(object) {};
+	bool operator==(const protected_handle& other) const = default;
 
-	~protected_data() {}
+	M* mutex() const
+	{
+		return mutex_;
+	}
+
+	T* object() const
+	{
+		return object_;
+	}
 
 	// get_unique()
 	// 
 	// Acquires the unique_lock of the mutex and returns a unique_guard
-	unique_guard<T, M> get_unique()
+	unique_guard<T, M> get_unique() const
 	{
-		return unique_guard<T, M>(mutex_, object_);
+		return unique_guard<T, M>(*mutex_, *object_);
 	}
 
 	// get_shared()
 	// 
-	// Acquires the shared_lock of the mutex and returns a shared_guard
+	// Acquires the shared_lock of the mutex and returns a shared_guard<T, M>
 	// Mutex must be SharedLockable
-	shared_guard<T, M> get_shared() const
+	auto get_shared() const requires SharedLockable<M>
+	{
+		return shared_guard<T, M>(*mutex_, *object_);
+	}
+
+	// get_unique(stoken)
+	// 
+	// Waits for the unique_lock of the mutex until it is acquired or a stop
+	// is requested on stoken, returns an empty optional in the latter case
+	std::optional<unique_guard<T, M>> get_unique(std::stop_token stoken) const requires StopLockable<M>
+	{
+		if (!mutex_->lock(stoken))
+			return {};
+		return std::optional<unique_guard<T, M>>(std::in_place, *mutex_, *object_, std::adopt_lock);
+	}
+
+	// get_shared(stoken)
+	// 
+	// Waits for the shared_lock of the mutex until it is acquired or a stop
+	// is requested on stoken, returns an empty optional in the latter case
+	auto get_shared(std::stop_token stoken) const requires StopSharedLockable<M>
 	{
-		return shared_guard(*this);
+		if (!mutex_->lock_shared(stoken))
+			return std::optional<shared_guard<T, M>>();
+		return std::optional<shared_guard<T, M>>(std::in_place, *mutex_, *object_, std::adopt_lock);
 	}
 
 	// can_cast_to<U>()
@@ -215,32 +694,31 @@ public:
 	template<typename U>
 	bool can_cast_to() const
 	{
-		const U* ptr = dynamic_cast<const U*>(&object_);
-		return ptr != nullptr;
+		return dynamic_cast<const U*>(object_) != nullptr;
 	}
 
 	// get_unique_cast()
 	// 
-	// Tries to dynamically cast the data to type U and returns a 
-	// unique_guard of type U without any lock
+	// Tries to dynamically cast the data to type U and returns a
+	// unique_guard of type U
 	template<typename U>
-	std::optional<unique_guard<U, M>> get_unique_cast()
+	std::optional<unique_guard<U, M>> get_unique_cast() const
 	{
-		if (U* ptr = dynamic_cast<U*>(&object_))
-			return std::optional<unique_guard<U, M>>(std::in_place, mutex_, *ptr);
+		if (U* ptr = dynamic_cast<U*>(object_))
+			return std::optional<unique_guard<U, M>>(std::in_place, *mutex_, *ptr);
 		else
 			return {};
 	}
 
 	// get_shared_cast()
 	// 
-	// Tries to dynamically cast the data to type U and returns a 
+	// Tries to dynamically cast the data to type U and returns a
 	// shared_guard of type U
 	template<typename U>
-	std::optional<shared_guard<U, M>> get_shared_cast() const
+	std::optional<shared_guard<U, M>> get_shared_cast() const requires SharedLockable<M>
 	{
-		if (const U* ptr = dynamic_cast<const U*>(&object_))
-			return std::optional<shared_guard<U, M>>(std::in_place, mutex_, *ptr);
+		if (const U* ptr = dynamic_cast<const U*>(object_))
+			return std::optional<shared_guard<U, M>>(std::in_place, *mutex_, *ptr);
 		else
 			return {};
 	}
@@ -248,34 +726,47 @@ public:
 
 // ----- protected_data pointer cast functions
 
-
-// get_shared_cast()
-// 
-// Tries to dynamically cast the data to type U and returns a 
-// shared_guard of type U
-//template<typename U>
-//std::optional<shared_guard<U, M>> get_shared_cast() const;
-
 // cast_shared_ptr_protected_data()
 // 
 // Creates an instance of shared_ptr<protected_data<U, M>> from shared_ptr<protected_data<T, M>>
 // if the cast is possible
-template<typename U, typename T, typename M>
-std::optional<std::shared_ptr<protected_data<U, M>>> cast_shared_ptr_protected_data(const std::shared_ptr<protected_data<T, M>>& p)
+template<typename U, typename T, typename M, typename... Policies>
+std::optional<std::shared_ptr<protected_data<U, M, Policies...>>> cast_shared_ptr_protected_data(const std::shared_ptr<protected_data<T, M, Policies...>>& p)
 {
-	if (p->can_cast_to<U>())
+	if (p->template can_cast_to<U>())
 	{
-		return std::reinterpret_pointer_cast<protected_data<U, M>>(p);
+		return std::reinterpret_pointer_cast<protected_data<U, M, Policies...>>(p);
 	}
 	return {};
 }
 
+// make_shared_protected<T, M, Policies...>()
+// 
+// Creates a shared_ptr<protected_data<T, M, Policies...>> with a single
+// allocation, with an enabled footprint policy the shared_ptr control block
+// is accounted to the group of the protected_data
+template<typename T, typename M, typename... Policies, typename... Args>
+std::shared_ptr<protected_data<T, M, Policies...>> make_shared_protected(Args&&... args)
+{
+	using pd_type = protected_data<T, M, Policies...>;
+	if constexpr (pd_type::footprint_policy::enabled)
+		return std::allocate_shared<pd_type>(footprint_allocator<pd_type, pd_type>(), std::forward<Args>(args)...);
+	else
+		return std::make_shared<pd_type>(std::forward<Args>(args)...);
+}
+
 // ------- Method definitions for unique_guard and shared_guard constructors
 template <typename T, typename M>
 requires Lockable<M>
-unique_guard<T,M>::unique_guard(protected_data<T, M>& pd) : lock_(pd.mutex_), object_(pd.object_) {};
+template <typename... Policies>
+requires std::same_as<protected_lock_t<M, Policies...>, M>
+unique_guard<T, M>::unique_guard(protected_data<T, M, Policies...>& pd)
+	: lock_(protected_data_access::mutex(pd)), object_(protected_data_access::object(pd)) {};
 
 template <typename T, typename M>
 requires SharedLockable<M>
-shared_guard<T, M>::shared_guard(const protected_data<T, M>& pd) : lock_(pd.mutex_), object_(pd.object_) {};
-#endif
\ No newline at end of file
+template <typename... Policies>
+requires std::same_as<protected_lock_t<M, Policies...>, M>
+shared_guard<T, M>::shared_guard(const protected_data<T, M, Policies...>& pd)
+	: lock_(protected_data_access::mutex(pd)), object_(protected_data_access::object(pd)) {};
+#endif
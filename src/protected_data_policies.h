@@ -0,0 +1,643 @@
+#ifndef PROTECTED_DATA_POLICIES
+#define PROTECTED_DATA_POLICIES
+
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
+
+#if defined(__GNUG__)
+#include <cxxabi.h>
+#include <cstdlib>
+#endif
+
+// ----- Policies of protected_data<T, M, Policies...>
+// 
+// The synchronization strategy is the mutex type M, the remaining aspects
+// are selected by the optional Policies, in any order and at most one per
+// category. Every policy declares its category with a policy_category member
+// type. Omitted categories fall back to zero overhead defaults:
+// 
+// layout : default_layout, cache_aligned, split_layout
+// stats : no_stats, sampled_stats<SampleRate>
+// reclaim : immediate_reclaim, quiescent_reclaim
+// footprint : no_footprint, footprint_accounting<Tag>
+// 
+// e.g. protected_data<Shape, spin_lock, cache_aligned, sampled_stats<64>>
+
+struct layout_policy_tag {};
+struct stats_policy_tag {};
+struct reclaim_policy_tag {};
+struct footprint_policy_tag {};
+
+// select_policy<Category, Default, Policies...>
+// 
+// Picks the policy of the given category from Policies, or Default
+template<typename Category, typename Default, typename... Policies>
+struct select_policy
+{
+	using type = Default;
+};
+
+template<typename Category, typename Default, typename P, typename... Policies>
+struct select_policy<Category, Default, P, Policies...>
+{
+	using type = std::conditional_t<std::is_same_v<typename P::policy_category, Category>,
+		P, typename select_policy<Category, Default, Policies...>::type>;
+};
+
+template<typename Category, typename Default, typename... Policies>
+using select_policy_t = typename select_policy<Category, Default, Policies...>::type;
+
+template<typename P>
+concept ProtectedDataPolicy = std::is_same_v<typename P::policy_category, layout_policy_tag>
+	|| std::is_same_v<typename P::policy_category, stats_policy_tag>
+	|| std::is_same_v<typename P::policy_category, reclaim_policy_tag>
+	|| std::is_same_v<typename P::policy_category, footprint_policy_tag>;
+
+template<typename Category, typename... Policies>
+constexpr std::size_t policy_count = (std::size_t(0) + ... + std::size_t(std::is_same_v<typename Policies::policy_category, Category>));
+
+template<typename... Policies>
+constexpr bool valid_policies = (ProtectedDataPolicy<Policies> && ...)
+	&& policy_count<layout_policy_tag, Policies...> <= 1
+	&& policy_count<stats_policy_tag, Policies...> <= 1
+	&& policy_count<reclaim_policy_tag, Policies...> <= 1
+	&& policy_count<footprint_policy_tag, Policies...> <= 1;
+
+constexpr std::size_t cache_line_size = 64;
+
+// ----- layout policies
+// 
+// mutex_alignment and object_alignment are applied with alignas to the mutex
+// and the object members, 0 keeps the natural alignment
+
+// default_layout
+// 
+// Mutex and object are packed with their natural alignment
+struct default_layout
+{
+	using policy_category = layout_policy_tag;
+	static constexpr std::size_t mutex_alignment = 0;
+	static constexpr std::size_t object_alignment = 0;
+};
+
+// cache_aligned
+// 
+// The whole protected_data starts at and is padded to a cache line, so it
+// never shares a line with neighbouring objects in arrays and containers
+struct cache_aligned
+{
+	using policy_category = layout_policy_tag;
+	static constexpr std::size_t mutex_alignment = cache_line_size;
+	static constexpr std::size_t object_alignment = 0;
+};
+
+// split_layout
+// 
+// Mutex and object are placed on separate cache lines, so spinning waiters
+// don't slow down the lock holder working on the object
+struct split_layout
+{
+	using policy_category = layout_policy_tag;
+	static constexpr std::size_t mutex_alignment = cache_line_size;
+	static constexpr std::size_t object_alignment = cache_line_size;
+};
+
+// ----- stats policies
+// 
+// A stats policy maps the mutex type to the lock type that is stored in
+// the protected_data and used by its guards
+
+// no_stats
+// 
+// The mutex is used as is
+struct no_stats
+{
+	using policy_category = stats_policy_tag;
+
+	template<typename M>
+	using lock_type = M;
+};
+
+// lock_stats
+// 
+// Snapshot of the statistics collected by an instrumented_lock.
+// Counters only cover the sampled acquisitions, multiply by sample_rate
+// to estimate the totals.
+struct lock_stats
+{
+	std::uint64_t sample_rate = 0;
+	std::uint64_t exclusive_samples = 0;
+	std::uint64_t shared_samples = 0;
+	// sampled exclusive acquisitions that only read the object (protected_data::read)
+	std::uint64_t read_samples = 0;
+	// sampled acquisitions that could not get the lock immediately
+	std::uint64_t contended_samples = 0;
+	std::uint64_t wait_ns = 0;
+	std::uint64_t exclusive_hold_ns = 0;
+	std::uint64_t shared_hold_ns = 0;
+	// distinct threads seen by the samples, saturates at 64
+	unsigned int threads = 0;
+	// time since the lock was constructed
+	std::uint64_t elapsed_ns = 0;
+};
+
+// instrumented_lock<M, SampleRate>
+// 
+// M : underlying mutex type
+// SampleRate : on average every SampleRate-th acquisition of a thread is measured
+// 
+// Forwards to M and measures wait time, hold time and contention of sampled
+// acquisitions. Acquisitions that are not sampled only cost a thread local
+// countdown decrement. The intervals between samples are random, so a
+// workload that writes every SampleRate-th operation is not sampled on
+// the same phase every time.
+template<typename M, unsigned int SampleRate>
+class instrumented_lock
+{
+	static_assert(SampleRate > 0);
+
+	using clock = std::chrono::steady_clock;
+
+	struct sample_state
+	{
+		const void* lock = nullptr;
+		clock::time_point acquired;
+		// acquisitions until the next sample, 0 before the first one is drawn
+		unsigned int countdown = 0;
+		// xorshift64 state, seeded on first use
+		std::uint64_t random = 0;
+	};
+
+	static inline thread_local sample_state sample_;
+
+	M mutex_;
+	std::atomic<std::uint64_t> exclusive_samples_{ 0 };
+	std::atomic<std::uint64_t> shared_samples_{ 0 };
+	std::atomic<std::uint64_t> read_samples_{ 0 };
+	std::atomic<std::uint64_t> contended_samples_{ 0 };
+	std::atomic<std::uint64_t> wait_ns_{ 0 };
+	std::atomic<std::uint64_t> exclusive_hold_ns_{ 0 };
+	std::atomic<std::uint64_t> shared_hold_ns_{ 0 };
+	std::atomic<std::uint64_t> thread_mask_{ 0 };
+	const clock::time_point created_ = clock::now();
+
+	instrumented_lock(const instrumented_lock& other) = delete;
+	instrumented_lock& operator=(const instrumented_lock& other) = delete;
+
+	static std::uint64_t nanoseconds(clock::duration d)
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+	}
+
+	// uniform in [1, 2 * SampleRate - 1], the mean interval is SampleRate
+	static unsigned int next_interval()
+	{
+		std::uint64_t& x = sample_.random;
+		if (x == 0)
+			x = std::hash<std::thread::id>{}(std::this_thread::get_id()) | 1;
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		return static_cast<unsigned int>(1 + x % (2 * std::uint64_t(SampleRate) - 1));
+	}
+
+	// only one sampled hold per thread is tracked at a time
+	bool should_sample() const
+	{
+		if (sample_.countdown > 1)
+		{
+			--sample_.countdown;
+			return false;
+		}
+		bool drawn = sample_.countdown == 1;
+		sample_.countdown = next_interval();
+		return drawn && sample_.lock == nullptr;
+	}
+
+	template<typename Lock, typename TryLock>
+	void sampled_acquire(std::atomic<std::uint64_t>& samples, Lock&& lock, TryLock&& try_lock)
+	{
+		auto start = clock::now();
+		bool contended;
+		if constexpr (std::is_same_v<std::decay_t<TryLock>, std::nullptr_t>)
+		{
+			lock();
+			contended = false;
+		}
+		else
+		{
+			contended = !try_lock();
+			if (contended)
+				lock();
+		}
+		auto acquired = clock::now();
+
+		std::uint64_t waited = nanoseconds(acquired - start);
+		// without try_lock, waits longer than a microsecond count as contended
+		if constexpr (std::is_same_v<std::decay_t<TryLock>, std::nullptr_t>)
+			contended = waited > 1000;
+
+		samples.fetch_add(1, std::memory_order_relaxed);
+		wait_ns_.fetch_add(waited, std::memory_order_relaxed);
+		if (contended)
+			contended_samples_.fetch_add(1, std::memory_order_relaxed);
+		thread_mask_.fetch_or(std::uint64_t(1) << (std::hash<std::thread::id>{}(std::this_thread::get_id()) % 64), std::memory_order_relaxed);
+
+		sample_.lock = this;
+		sample_.acquired = acquired;
+	}
+
+	void sampled_release(std::atomic<std::uint64_t>& hold_ns)
+	{
+		if (sample_.lock != this)
+			return;
+		hold_ns.fetch_add(nanoseconds(clock::now() - sample_.acquired), std::memory_order_relaxed);
+		sample_.lock = nullptr;
+	}
+
+public:
+	instrumented_lock() = default;
+
+	void lock()
+	{
+		if (!should_sample())
+			return mutex_.lock();
+
+		if constexpr (requires { mutex_.try_lock(); })
+			sampled_acquire(exclusive_samples_, [this] { mutex_.lock(); }, [this] { return mutex_.try_lock(); });
+		else
+			sampled_acquire(exclusive_samples_, [this] { mutex_.lock(); }, nullptr);
+	}
+
+	bool try_lock() requires requires(M m) { { m.try_lock() } -> std::convertible_to<bool>; }
+	{
+		return mutex_.try_lock();
+	}
+
+	bool lock(std::stop_token stoken) requires requires(M m, std::stop_token st) { { m.lock(st) } -> std::same_as<bool>; }
+	{
+		return mutex_.lock(stoken);
+	}
+
+	void unlock()
+	{
+		sampled_release(exclusive_hold_ns_);
+		mutex_.unlock();
+	}
+
+	void lock_shared() requires requires(M m) { m.lock_shared(); m.unlock_shared(); }
+	{
+		if (!should_sample())
+			return mutex_.lock_shared();
+
+		if constexpr (requires { mutex_.try_lock_shared(); })
+			sampled_acquire(shared_samples_, [this] { mutex_.lock_shared(); }, [this] { return mutex_.try_lock_shared(); });
+		else
+			sampled_acquire(shared_samples_, [this] { mutex_.lock_shared(); }, nullptr);
+	}
+
+	bool try_lock_shared() requires requires(M m) { { m.try_lock_shared() } -> std::convertible_to<bool>; }
+	{
+		return mutex_.try_lock_shared();
+	}
+
+	bool lock_shared(std::stop_token stoken) requires requires(M m, std::stop_token st) { { m.lock_shared(st) } -> std::same_as<bool>; }
+	{
+		return mutex_.lock_shared(stoken);
+	}
+
+	void unlock_shared() requires requires(M m) { m.lock_shared(); m.unlock_shared(); }
+	{
+		sampled_release(shared_hold_ns_);
+		mutex_.unlock_shared();
+	}
+
+	// mark_read()
+	// 
+	// Called by the holder of the exclusive lock if it only reads the object,
+	// lets the statistics show the read ratio of locks without shared mode
+	void mark_read()
+	{
+		if (sample_.lock == this)
+			read_samples_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void bind_region(const void* object, std::size_t size) requires requires(M m, const void* p, std::size_t n) { m.bind_region(p, n); }
+	{
+		mutex_.bind_region(object, size);
+	}
+
+	template<typename T>
+	void bind_object(const T& object) requires requires(M m, const T& o) { m.bind_object(o); }
+	{
+		mutex_.bind_object(object);
+	}
+
+	auto published() const requires requires(const M& m) { m.published(); }
+	{
+		return mutex_.published();
+	}
+
+	void freeze() requires requires(M m) { m.freeze(); m.thaw(); }
+	{
+		mutex_.freeze();
+	}
+
+	void thaw() requires requires(M m) { m.freeze(); m.thaw(); }
+	{
+		mutex_.thaw();
+	}
+
+	bool is_frozen() const requires requires(const M& m) { { m.is_frozen() } -> std::same_as<bool>; }
+	{
+		return mutex_.is_frozen();
+	}
+
+	// stats()
+	// 
+	// Returns a snapshot of the collected statistics
+	lock_stats stats() const
+	{
+		lock_stats s;
+		s.sample_rate = SampleRate;
+		s.exclusive_samples = exclusive_samples_.load(std::memory_order_relaxed);
+		s.shared_samples = shared_samples_.load(std::memory_order_relaxed);
+		s.read_samples = read_samples_.load(std::memory_order_relaxed);
+		s.contended_samples = contended_samples_.load(std::memory_order_relaxed);
+		s.wait_ns = wait_ns_.load(std::memory_order_relaxed);
+		s.exclusive_hold_ns = exclusive_hold_ns_.load(std::memory_order_relaxed);
+		s.shared_hold_ns = shared_hold_ns_.load(std::memory_order_relaxed);
+		s.threads = std::popcount(thread_mask_.load(std::memory_order_relaxed));
+		s.elapsed_ns = nanoseconds(clock::now() - created_);
+		return s;
+	}
+};
+
+// sampled_stats<SampleRate>
+// 
+// Wraps the mutex in an instrumented_lock, statistics are available via
+// protected_data::stats()
+template<unsigned int SampleRate = 64>
+struct sampled_stats
+{
+	using policy_category = stats_policy_tag;
+
+	template<typename M>
+	using lock_type = instrumented_lock<M, SampleRate>;
+};
+
+// ----- reclaim policies
+// 
+// Decide what happens before the protected object is destroyed
+
+// immediate_reclaim
+// 
+// The object is destroyed right away, the owner guarantees that no guard
+// or handle outlives the protected_data
+struct immediate_reclaim
+{
+	using policy_category = reclaim_policy_tag;
+
+	template<typename L>
+	static void before_destroy(L&) {}
+};
+
+// quiescent_reclaim
+// 
+// The destructor acquires the exclusive lock once before destroying the
+// object, so it waits for the guards that exist at that moment, e.g. ones
+// obtained through handles by other threads. It does not stop new ones: the
+// owner must first make the object unreachable (remove its handles, stop the
+// threads that look it up) so that no guard is requested once destruction
+// has started. Keeping the lock held through the destruction would not help,
+// a late acquirer would then wait on a mutex that is destroyed while locked.
+// A lock with a drain() member (freezable) is drained through it, its
+// readers may hold no lock at all.
+struct quiescent_reclaim
+{
+	using policy_category = reclaim_policy_tag;
+
+	template<typename L>
+	static void before_destroy(L& lock)
+	{
+		if constexpr (requires { lock.drain(); })
+			lock.drain();
+		else
+		{
+			lock.lock();
+			lock.unlock();
+		}
+	}
+};
+
+// ----- footprint policies
+// 
+// Account the memory used by protected_data instances. An enabled policy
+// provides the footprint_counters of the group the protected_data belongs to.
+
+// footprint_stats
+// 
+// Snapshot of the memory accounted to a group, in bytes of live instances
+struct footprint_stats
+{
+	std::string group;
+	std::int64_t instances = 0;
+	// sizeof(T) of the protected objects, without memory they allocate themselves
+	std::int64_t object_bytes = 0;
+	// sizeof(lock_type), including the instrumentation of stats policies
+	std::int64_t mutex_bytes = 0;
+	// alignment padding inside protected_data, e.g. from cache_aligned
+	std::int64_t padding_bytes = 0;
+	// per object overhead of containers, e.g. poly_vector slot headers and slack
+	std::int64_t container_bytes = 0;
+	// shared_ptr control blocks of make_shared_protected()
+	std::int64_t control_block_bytes = 0;
+
+	std::int64_t total_bytes() const
+	{
+		return object_bytes + mutex_bytes + padding_bytes + container_bytes + control_block_bytes;
+	}
+};
+
+// footprint_counters
+// 
+// Live counters of one group, never destroyed. All groups are linked into
+// a global list that footprint_report() walks.
+class footprint_counters
+{
+	std::string group_;
+	footprint_counters* next_ = nullptr;
+
+	static inline std::atomic<footprint_counters*> head_{ nullptr };
+
+public:
+	std::atomic<std::int64_t> instances{ 0 };
+	std::atomic<std::int64_t> object_bytes{ 0 };
+	std::atomic<std::int64_t> mutex_bytes{ 0 };
+	std::atomic<std::int64_t> padding_bytes{ 0 };
+	std::atomic<std::int64_t> container_bytes{ 0 };
+	std::atomic<std::int64_t> control_block_bytes{ 0 };
+
+	explicit footprint_counters(std::string group) : group_(std::move(group))
+	{
+		next_ = head_.load(std::memory_order_relaxed);
+		while (!head_.compare_exchange_weak(next_, this, std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	footprint_counters(const footprint_counters& other) = delete;
+	footprint_counters& operator=(const footprint_counters& other) = delete;
+
+	footprint_stats snapshot() const
+	{
+		footprint_stats s;
+		s.group = group_;
+		s.instances = instances.load(std::memory_order_relaxed);
+		s.object_bytes = object_bytes.load(std::memory_order_relaxed);
+		s.mutex_bytes = mutex_bytes.load(std::memory_order_relaxed);
+		s.padding_bytes = padding_bytes.load(std::memory_order_relaxed);
+		s.container_bytes = container_bytes.load(std::memory_order_relaxed);
+		s.control_block_bytes = control_block_bytes.load(std::memory_order_relaxed);
+		return s;
+	}
+
+	template<typename F>
+	static void for_each(F&& f)
+	{
+		for (footprint_counters* c = head_.load(std::memory_order_acquire); c; c = c->next_)
+			f(*c);
+	}
+};
+
+// footprint_group_name<Key>()
+// 
+// Key::footprint_name if Key declares one, the demangled type name otherwise
+template<typename Key>
+std::string footprint_group_name()
+{
+	if constexpr (requires { { Key::footprint_name } -> std::convertible_to<const char*>; })
+		return Key::footprint_name;
+	else
+	{
+		// typeid of the pointer, tags are often incomplete types
+		const char* mangled = typeid(Key*).name();
+		std::string name = mangled;
+#if defined(__GNUG__)
+		int status = 0;
+		if (char* demangled = abi::__cxa_demangle(mangled, nullptr, nullptr, &status))
+		{
+			name = demangled;
+			std::free(demangled);
+		}
+#endif
+		if (!name.empty() && name.back() == '*')
+			name.pop_back();
+		return name;
+	}
+}
+
+template<typename Key>
+footprint_counters& footprint_group()
+{
+	static footprint_counters counters(footprint_group_name<Key>());
+	return counters;
+}
+
+// footprint_report()
+// 
+// Returns a snapshot of every group that has been used so far
+inline std::vector<footprint_stats> footprint_report()
+{
+	std::vector<footprint_stats> report;
+	footprint_counters::for_each([&](const footprint_counters& c) { report.push_back(c.snapshot()); });
+	return report;
+}
+
+// no_footprint
+// 
+// Nothing is accounted
+struct no_footprint
+{
+	using policy_category = footprint_policy_tag;
+	static constexpr bool enabled = false;
+};
+
+// footprint_accounting<Tag>
+// 
+// Tag : group of the accounted instances, void groups them by their
+//       protected_data<T, M, Policies...> type
+// 
+// Construction and destruction update the counters of the group with relaxed
+// atomic adds, the protected_data itself does not grow.
+// e.g. protected_data<Shape, std::shared_mutex, footprint_accounting<struct shapes>>
+template<typename Tag = void>
+struct footprint_accounting
+{
+	using policy_category = footprint_policy_tag;
+	static constexpr bool enabled = true;
+
+	template<typename PD>
+	static footprint_counters& counters()
+	{
+		return footprint_group<std::conditional_t<std::is_void_v<Tag>, PD, Tag>>();
+	}
+};
+
+// footprint_allocator<U, PD>
+// 
+// Allocator for std::allocate_shared of a PD with an enabled footprint
+// policy, accounts what the allocation adds to sizeof(PD) as control block
+template<typename U, typename PD>
+struct footprint_allocator
+{
+	using value_type = U;
+
+	footprint_allocator() = default;
+
+	template<typename V>
+	footprint_allocator(const footprint_allocator<V, PD>&) {};
+
+	U* allocate(std::size_t n)
+	{
+		U* p = static_cast<U*>(::operator new(n * sizeof(U), std::align_val_t(alignof(U))));
+		account(n, 1);
+		return p;
+	}
+
+	void deallocate(U* p, std::size_t n)
+	{
+		account(n, -1);
+		::operator delete(p, std::align_val_t(alignof(U)));
+	}
+
+	template<typename V>
+	bool operator==(const footprint_allocator<V, PD>&) const
+	{
+		return true;
+	}
+
+private:
+	static void account(std::size_t n, std::int64_t sign)
+	{
+		std::int64_t bytes = static_cast<std::int64_t>(n * sizeof(U)) - static_cast<std::int64_t>(sizeof(PD));
+		if (bytes > 0)
+			PD::footprint_policy::template counters<PD>().control_block_bytes.fetch_add(sign * bytes, std::memory_order_relaxed);
+	}
+};
+
+// protected_lock_t<M, Policies...>
+// 
+// The lock type stored in protected_data<T, M, Policies...>
+template<typename M, typename... Policies>
+using protected_lock_t = typename select_policy_t<stats_policy_tag, no_stats, Policies...>::template lock_type<M>;
+#endif
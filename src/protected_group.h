@@ -0,0 +1,230 @@
+#ifndef PROTECTED_GROUP
+#define PROTECTED_GROUP
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <utility>
+
+#include "protected_data.h"
+
+// ----- Lock coarsening
+// 
+// Objects that are always accessed together can share the mutex of a
+// protected_group instead of carrying one each. A protected_ref<T, L> stores
+// its object and a pointer to the group mutex, one guard of the group
+// covers all of its members.
+// 
+// e.g.
+// protected_group<std::shared_mutex> group;
+// decltype(group)::ref<Square> square(group, 5);
+// decltype(group)::ref<std::vector<int>> values(group);
+// {
+// 	auto guard = group.get_unique();
+// 	guard(square).set_edge(10);
+// 	guard(values).push_back(10);
+// }
+
+template<typename M, typename... Policies>
+requires Lockable<M> && valid_policies<Policies...>
+class protected_group;
+
+template<typename L>
+requires Lockable<L>
+class group_unique_guard;
+
+template<typename L>
+requires SharedLockable<L>
+class group_shared_guard;
+
+// protected_ref<T, L>
+// 
+// T : contained object type
+// L : lock type of the group
+// 
+// Object protected by the mutex of a protected_group. It can be accessed
+// through a guard of the group, or on its own with get_unique() and
+// get_shared(), which lock the whole group.
+template<typename T, typename L>
+requires Lockable<L>
+class protected_ref
+{
+	L* mutex_;
+	T object_;
+
+	friend class group_unique_guard<L>;
+	template<typename S>
+	requires SharedLockable<S>
+	friend class group_shared_guard;
+
+	protected_ref(const protected_ref& other) = delete;
+	protected_ref& operator=(protected_ref other) = delete;
+
+public:
+	template<typename M, typename... Policies, typename... Args>
+	requires std::same_as<protected_lock_t<M, Policies...>, L>
+	protected_ref(protected_group<M, Policies...>& group, Args&&... args)
+		: mutex_(&group.mutex_), object_(std::forward<Args>(args)...) {}
+
+	unique_guard<T, L> get_unique()
+	{
+		return unique_guard<T, L>(*mutex_, object_);
+	}
+
+	auto get_shared() const requires SharedLockable<L>
+	{
+		return shared_guard<T, L>(*mutex_, object_);
+	}
+
+	// belongs_to()
+	// 
+	// Returns whether the object is protected by the mutex of group
+	template<typename M, typename... Policies>
+	bool belongs_to(const protected_group<M, Policies...>& group) const
+	{
+		return mutex_ == &group.mutex_;
+	}
+};
+
+// group_unique_guard<L>
+// 
+// L : lock type of the group
+// 
+// Holds the exclusive lock of a protected_group, operator() gives access
+// to the objects of its members. Throws std::invalid_argument for objects
+// of another group.
+template<typename L>
+requires Lockable<L>
+class group_unique_guard
+{
+	std::unique_lock<L> lock_;
+
+	group_unique_guard(const group_unique_guard& other) = delete;
+	group_unique_guard& operator=(group_unique_guard other) = delete;
+
+public:
+	explicit group_unique_guard(L& mutex) : lock_(mutex) {};
+
+	template<typename T>
+	T& operator()(protected_ref<T, L>& ref) const
+	{
+		if (ref.mutex_ != lock_.mutex())
+			throw std::invalid_argument("protected_ref of another group");
+		return ref.object_;
+	}
+};
+
+// group_shared_guard<L>
+// 
+// L : lock type of the group
+// 
+// Holds the shared lock of a protected_group, operator() gives const access
+// to the objects of its members. Throws std::invalid_argument for objects
+// of another group.
+template<typename L>
+requires SharedLockable<L>
+class group_shared_guard
+{
+	std::shared_lock<L> lock_;
+
+	group_shared_guard(const group_shared_guard& other) = delete;
+	group_shared_guard& operator=(group_shared_guard other) = delete;
+
+public:
+	explicit group_shared_guard(L& mutex) : lock_(mutex) {};
+
+	template<typename T>
+	const T& operator()(const protected_ref<T, L>& ref) const
+	{
+		if (ref.mutex_ != lock_.mutex())
+			throw std::invalid_argument("protected_ref of another group");
+		return ref.object_;
+	}
+};
+
+// protected_group<M, Policies...>
+// 
+// M : mutex type
+// Policies : optional layout, stats and reclaim policies (see protected_data_policies.h)
+// 
+// Owns the single mutex of its protected_ref members. Unlike protected_data
+// it doesn't own the objects, members must not outlive the group.
+template<typename M, typename... Policies>
+requires Lockable<M> && valid_policies<Policies...>
+class protected_group
+{
+public:
+	using lock_type = protected_lock_t<M, Policies...>;
+	using layout_policy = select_policy_t<layout_policy_tag, default_layout, Policies...>;
+	using reclaim_policy = select_policy_t<reclaim_policy_tag, immediate_reclaim, Policies...>;
+
+	template<typename T>
+	using ref = protected_ref<T, lock_type>;
+
+private:
+	static constexpr std::size_t mutex_alignment = layout_policy::mutex_alignment > alignof(lock_type) ? layout_policy::mutex_alignment : alignof(lock_type);
+
+	alignas(mutex_alignment) mutable lock_type mutex_;
+
+	template<typename T, typename L>
+	requires Lockable<L>
+	friend class protected_ref;
+
+	protected_group(const protected_group& other) = delete;
+	protected_group& operator=(protected_group other) = delete;
+
+public:
+	protected_group() = default;
+
+	~protected_group()
+	{
+		reclaim_policy::before_destroy(mutex_);
+	}
+
+	group_unique_guard<lock_type> get_unique()
+	{
+		return group_unique_guard<lock_type>(mutex_);
+	}
+
+	auto get_shared() const requires SharedLockable<lock_type>
+	{
+		return group_shared_guard<lock_type>(mutex_);
+	}
+
+	// read()
+	// 
+	// Invokes f with a shared guard of the group if the lock type is
+	// SharedLockable, with a unique guard otherwise, and returns its result
+	template<typename F>
+	auto read(F&& f) const
+	{
+		if constexpr (SharedLockable<lock_type>)
+		{
+			auto guard = get_shared();
+			return std::invoke(std::forward<F>(f), std::as_const(guard));
+		}
+		else
+		{
+			group_unique_guard<lock_type> guard(mutex_);
+			return std::invoke(std::forward<F>(f), std::as_const(guard));
+		}
+	}
+
+	// write()
+	// 
+	// Invokes f with a unique guard of the group and returns its result
+	template<typename F>
+	auto write(F&& f)
+	{
+		auto guard = get_unique();
+		return std::invoke(std::forward<F>(f), std::as_const(guard));
+	}
+
+	lock_stats stats() const requires requires(const lock_type& l) { l.stats(); }
+	{
+		return mutex_.stats();
+	}
+};
+#endif
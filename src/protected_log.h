@@ -0,0 +1,437 @@
+#ifndef PROTECTED_LOG
+#define PROTECTED_LOG
+
+#if defined(__unix__)
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <stop_token>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "protected_data_policies.h"
+
+// protected_log
+// 
+// Append only log buffer shared by many threads. A record is appended in
+// three steps without any lock: the space is reserved in the current
+// segment with a fetch_add, filled, and committed by adding its size to the
+// committed counter of the segment. The reservation that crosses the end of
+// a segment seals it and installs the next one, later reservations retry there.
+// A background flusher writes the segments that are sealed and fully committed,
+// consecutive ones with a single writev, and seals the current segment itself
+// when it has been partially filled for flush_interval.
+// 
+// Records are never split or interleaved, their order in the output is the
+// order of their reservations. When all segments are waiting to be written,
+// appending blocks until the flusher catches up.
+// A thread must commit its record before reserving the next one, a sealing
+// reservation may wait for the segments that are still being filled.
+// 
+// e.g.
+// protected_log log(STDOUT_FILENO);
+// log.append("message\n");
+// {
+// 	auto record = log.reserve(n);
+// 	format_into(record.data(), n);
+// } // committed
+class protected_log
+{
+	static constexpr std::size_t not_sealed = ~std::size_t(0);
+
+	struct segment
+	{
+		std::unique_ptr<char[]> data;
+		// sequence number of the current use, written by the sealer of the
+		// previous segment before publishing this one. A stale current_ may
+		// still point to a written segment while it is reset, hence atomic.
+		std::atomic<std::uint64_t> seq{ 0 };
+		// bytes reserved, larger than the capacity once sealed
+		alignas(cache_line_size) std::atomic<std::size_t> reserved{ 0 };
+		// bytes of the committed records
+		alignas(cache_line_size) std::atomic<std::size_t> committed{ 0 };
+		// valid bytes, set by the reservation that sealed the segment
+		std::atomic<std::size_t> sealed_size{ not_sealed };
+		// written out and available for reuse
+		std::atomic<bool> free{ true };
+	};
+
+public:
+	// log_record
+	// 
+	// Space reserved for one record, committed when destroyed
+	class log_record
+	{
+		segment* segment_;
+		char* data_;
+		std::size_t size_;
+
+		friend class protected_log;
+
+		log_record(segment* seg, std::size_t offset, std::size_t size)
+			: segment_(seg), data_(seg->data.get() + offset), size_(size) {}
+
+		log_record(const log_record& other) = delete;
+		log_record& operator=(const log_record& other) = delete;
+
+	public:
+		log_record(log_record&& other) noexcept
+			: segment_(std::exchange(other.segment_, nullptr)), data_(other.data_), size_(other.size_) {}
+
+		~log_record()
+		{
+			if (segment_)
+				segment_->committed.fetch_add(size_, std::memory_order_release);
+		}
+
+		char* data() const { return data_; }
+		std::size_t size() const { return size_; }
+	};
+
+	// protected_log()
+	// 
+	// fd : file descriptor to write to, not closed by the log
+	// segment_size : capacity of a segment, the maximum size of a record
+	// segments : number of segments, more segments absorb longer bursts
+	// flush_interval : maximum time a record waits in a partially filled segment
+	explicit protected_log(int fd, std::size_t segment_size = 64 * 1024, std::size_t segments = 4,
+		std::chrono::milliseconds flush_interval = std::chrono::milliseconds(10))
+		: protected_log(fd, segment_size, segments, flush_interval, false)
+	{
+	}
+
+	// protected_log()
+	// 
+	// Appends to the file at path, throws std::system_error if it cannot be opened
+	explicit protected_log(const char* path, std::size_t segment_size = 64 * 1024, std::size_t segments = 4,
+		std::chrono::milliseconds flush_interval = std::chrono::milliseconds(10))
+		: protected_log(open_file(path), segment_size, segments, flush_interval, true)
+	{
+	}
+
+	protected_log(const protected_log& other) = delete;
+	protected_log& operator=(const protected_log& other) = delete;
+
+	// all appends must have finished, pending records are written before returning
+	~protected_log()
+	{
+		try
+		{
+			flush();
+		}
+		catch (const std::system_error&)
+		{
+		}
+		flusher_.request_stop();
+		flusher_.join();
+		if (owns_fd_)
+			::close(fd_);
+	}
+
+	// reserve()
+	// 
+	// Reserves size bytes for a record, throws std::length_error if size is
+	// zero or larger than a segment
+	log_record reserve(std::size_t size)
+	{
+		if (size == 0 || size > capacity_)
+			throw std::length_error("protected_log record size");
+
+		for (;;)
+		{
+			segment* seg = current_.load(std::memory_order_acquire);
+			std::uint64_t seq = seg->seq.load(std::memory_order_relaxed);
+			std::size_t offset = seg->reserved.fetch_add(size, std::memory_order_acq_rel);
+			if (offset + size <= capacity_)
+				return log_record(seg, offset, size);
+
+			// exactly one reservation starts inside and ends outside the segment
+			if (offset <= capacity_)
+				seal(seg, offset);
+			else
+			{
+				// wait for the sequence number, the same segment may be current again
+				std::unique_lock lk(rotate_mutex_);
+				rotated_.wait(lk, [&] { return current_.load(std::memory_order_acquire)->seq.load(std::memory_order_relaxed) != seq; });
+			}
+		}
+	}
+
+	// append()
+	// 
+	// Copies message into the log as one record
+	void append(std::string_view message)
+	{
+		auto record = reserve(message.size());
+		std::memcpy(record.data(), message.data(), message.size());
+	}
+
+	// flush()
+	// 
+	// Waits until the records committed before the call are written,
+	// throws std::system_error if writing failed
+	void flush()
+	{
+		segment* seg = current_.load(std::memory_order_acquire);
+		std::uint64_t target = seg->seq.load(std::memory_order_relaxed) + (seg->reserved.load(std::memory_order_acquire) != 0 ? 1 : 0);
+
+		std::unique_lock lk(mutex_);
+		if (flush_target_ < target)
+			flush_target_ = target;
+		wake_.notify_all();
+		flushed_cv_.wait(lk, [&] { return flushed_ >= target || error_ != 0; });
+		if (error_ != 0)
+			throw std::system_error(error_, std::system_category(), "protected_log writev");
+	}
+
+private:
+	int fd_;
+	bool owns_fd_ = false;
+	const std::size_t capacity_;
+	const std::size_t n_segments_;
+	std::unique_ptr<segment[]> segments_;
+	const std::chrono::milliseconds flush_interval_;
+	alignas(cache_line_size) std::atomic<segment*> current_{ nullptr };
+	// slow path of reservations, waiting for the next segment
+	std::mutex rotate_mutex_;
+	std::condition_variable rotated_;
+
+	// flusher state
+	std::mutex mutex_;
+	std::condition_variable_any wake_;
+	std::condition_variable_any flushed_cv_;
+	// number of segments the flush() callers wait for, the request is
+	// served once flushed_ reaches it
+	std::uint64_t flush_target_ = 0;
+	// number of segments written
+	std::uint64_t flushed_ = 0;
+	// sealed by the flusher, the next segment is installed once it is written
+	segment* pending_install_ = nullptr;
+	int error_ = 0;
+	std::jthread flusher_;
+
+	static int open_file(const char* path)
+	{
+		int fd = ::open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+		if (fd < 0)
+			throw std::system_error(errno, std::system_category(), "protected_log open");
+		return fd;
+	}
+
+	// owns_fd : the fd is closed by the destructor, or here if construction fails
+	protected_log(int fd, std::size_t segment_size, std::size_t segments, std::chrono::milliseconds flush_interval, bool owns_fd)
+		: fd_(fd), owns_fd_(owns_fd), capacity_(segment_size), n_segments_(segments < 2 ? 2 : segments),
+		flush_interval_(flush_interval)
+	{
+		try
+		{
+			segments_ = std::make_unique<segment[]>(n_segments_);
+			for (std::size_t i = 0; i < n_segments_; i++)
+				segments_[i].data = std::make_unique<char[]>(capacity_);
+			segments_[0].free.store(false, std::memory_order_relaxed);
+			current_.store(&segments_[0], std::memory_order_release);
+			flusher_ = std::jthread([this](std::stop_token stoken) { flush_loop(stoken); });
+		}
+		catch (...)
+		{
+			if (owns_fd_)
+				::close(fd_);
+			throw;
+		}
+	}
+
+	segment& next_of(const segment* seg)
+	{
+		return segments_[(seg->seq.load(std::memory_order_relaxed) + 1) % n_segments_];
+	}
+
+	// called once per segment by the sealing reservation, installs the next
+	// segment as soon as the flusher has written its previous contents
+	void seal(segment* seg, std::size_t size)
+	{
+		seg->sealed_size.store(size, std::memory_order_release);
+		wake_flusher();
+
+		segment& next = next_of(seg);
+		{
+			std::unique_lock lk(rotate_mutex_);
+			rotated_.wait(lk, [&] { return next.free.load(std::memory_order_acquire); });
+		}
+		install_next(seg);
+	}
+
+	void wake_flusher()
+	{
+		// a flusher between its predicate check and its wait holds mutex_
+		{
+			std::lock_guard lk(mutex_);
+		}
+		wake_.notify_all();
+	}
+
+	// next_of(seg) must be free
+	void install_next(segment* seg)
+	{
+		segment& next = next_of(seg);
+		next.free.store(false, std::memory_order_relaxed);
+		next.seq.store(seg->seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		next.committed.store(0, std::memory_order_relaxed);
+		next.sealed_size.store(not_sealed, std::memory_order_relaxed);
+		next.reserved.store(0, std::memory_order_release);
+
+		{
+			std::lock_guard lk(rotate_mutex_);
+			current_.store(&next, std::memory_order_release);
+		}
+		rotated_.notify_all();
+	}
+
+	// writes the consecutive complete segments with one writev
+	// returns whether anything was written
+	bool write_completed(std::uint64_t& seq)
+	{
+		std::vector<iovec> iov;
+		std::uint64_t end = seq;
+		for (; end - seq < n_segments_; end++)
+		{
+			segment& seg = segments_[end % n_segments_];
+			std::size_t size = seg.sealed_size.load(std::memory_order_acquire);
+			if (size == not_sealed || seg.committed.load(std::memory_order_acquire) != size)
+				break;
+			if (size != 0)
+				iov.push_back({ seg.data.get(), size });
+		}
+		if (end == seq)
+			return false;
+
+		int error = write_all(iov);
+
+		{
+			std::lock_guard lk(rotate_mutex_);
+			for (; seq != end; seq++)
+			{
+				segment& seg = segments_[seq % n_segments_];
+				seg.sealed_size.store(not_sealed, std::memory_order_relaxed);
+				seg.free.store(true, std::memory_order_release);
+			}
+		}
+		rotated_.notify_all();
+
+		{
+			std::lock_guard lk(mutex_);
+			flushed_ = seq;
+			if (error != 0)
+				error_ = error;
+		}
+		flushed_cv_.notify_all();
+		return true;
+	}
+
+	int write_all(std::vector<iovec>& iov)
+	{
+		iovec* first = iov.data();
+		int count = static_cast<int>(iov.size());
+		while (count > 0)
+		{
+			ssize_t written = ::writev(fd_, first, count < IOV_MAX ? count : IOV_MAX);
+			if (written < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				return errno;
+			}
+			// skip what was written, a partial write continues inside an iovec
+			std::size_t n = static_cast<std::size_t>(written);
+			while (count > 0 && n >= first->iov_len)
+			{
+				n -= first->iov_len;
+				first++;
+				count--;
+			}
+			if (count > 0)
+			{
+				first->iov_base = static_cast<char*>(first->iov_base) + n;
+				first->iov_len -= n;
+			}
+		}
+		return 0;
+	}
+
+	// seals a partially filled current segment, the flusher never waits for
+	// the next segment itself, it installs it once that one is written
+	void seal_current()
+	{
+		if (pending_install_)
+			return;
+		segment* seg = current_.load(std::memory_order_acquire);
+		if (seg->reserved.load(std::memory_order_relaxed) == 0)
+			return;
+		// every later reservation fails, the one before decides who seals
+		std::size_t offset = seg->reserved.fetch_add(capacity_ + 1, std::memory_order_acq_rel);
+		if (offset > capacity_)
+			return;
+		seg->sealed_size.store(offset, std::memory_order_release);
+		pending_install_ = seg;
+		install_pending();
+	}
+
+	void install_pending()
+	{
+		if (pending_install_ && next_of(pending_install_).free.load(std::memory_order_acquire))
+		{
+			install_next(pending_install_);
+			pending_install_ = nullptr;
+		}
+	}
+
+	void flush_loop(std::stop_token stoken)
+	{
+		std::uint64_t seq = 0;
+		while (!stoken.stop_requested())
+		{
+			bool timed_out, flush_current;
+			{
+				std::unique_lock lk(mutex_);
+				timed_out = !wake_.wait_for(lk, stoken, flush_interval_, [&] {
+					return flush_target_ > flushed_ || segments_[seq % n_segments_].sealed_size.load(std::memory_order_acquire) != not_sealed;
+					});
+				// the current segment is only sealed early if a flush() waits for it
+				flush_current = current_.load(std::memory_order_acquire)->seq.load(std::memory_order_relaxed) < flush_target_;
+			}
+
+			bool wrote = write_completed(seq);
+			install_pending();
+			if (timed_out || flush_current)
+				seal_current();
+			wrote = write_completed(seq) || wrote;
+			install_pending();
+
+			std::unique_lock lk(mutex_);
+			if (flush_target_ > flushed_ && !wrote)
+			{
+				// a committing record is still being filled, give it time
+				lk.unlock();
+				std::this_thread::yield();
+			}
+		}
+	}
+};
+
+#endif
+#endif
@@ -0,0 +1,389 @@
+#ifndef PROTECTED_REGISTRY
+#define PROTECTED_REGISTRY
+
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <typeindex>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "protected_data.h"
+#include "poly_vector.h"
+
+// registry_index_base<Base, L>
+// 
+// Interface through which protected_registry keeps its secondary indexes
+// up to date, update() is called with the object still locked
+template<typename Base, typename L>
+struct registry_index_base
+{
+	virtual ~registry_index_base() = default;
+	virtual void update(const protected_handle<Base, L>& handle, const Base& object) = 0;
+};
+
+template<typename Base, typename L>
+using registry_index_list = std::vector<std::unique_ptr<registry_index_base<Base, L>>>;
+
+template<typename Base, typename L>
+requires Lockable<L>
+class indexed_guard;
+
+// registry_index<Base, L, Key, KeyOf>
+// 
+// Base : common base type of the registered objects
+// L : lock type of the registered objects
+// Key : hashable key type, constructible from the result of KeyOf
+// KeyOf : callable returning the key of a const Base&, e.g. &Shape::get_name
+// 
+// Secondary index of a protected_registry mapping keys to handles, created
+// with protected_registry::add_index(). The key of an object is recorded
+// when it is inserted and whenever an indexed_guard is released, before the
+// object is unlocked. indexed_guards are returned by
+// protected_registry::get_unique() and find_unique(), lookups never miss a
+// key committed through them. Changes made through other guards, e.g.
+// protected_handle::get_unique() or get_unique_cast(), are not seen until
+// protected_registry::reindex() or the next indexed_guard of the object.
+// A key may change right after a lookup, find_shared() and find_unique()
+// lock the candidates and check their key again.
+// Keys don't have to be unique.
+template<typename Base, typename L, typename Key, typename KeyOf>
+class registry_index : public registry_index_base<Base, L>
+{
+public:
+	using handle_type = protected_handle<Base, L>;
+
+private:
+	struct entries
+	{
+		std::unordered_multimap<Key, handle_type> by_key;
+		// key recorded for each object, to find its old entry in by_key
+		std::unordered_map<const Base*, Key> key_of_object;
+	};
+
+	KeyOf key_of_;
+	// all indexes of the registry, updated by the guards of find_unique()
+	const registry_index_list<Base, L>& indexes_;
+	protected_data<entries, std::shared_mutex> entries_;
+
+	bool has_key(const Base& object, const Key& key) const
+	{
+		return Key(std::invoke(key_of_, object)) == key;
+	}
+
+public:
+	registry_index(KeyOf key_of, const registry_index_list<Base, L>& indexes) : key_of_(std::move(key_of)), indexes_(indexes) {};
+
+	void update(const handle_type& handle, const Base& object) override
+	{
+		Key key(std::invoke(key_of_, object));
+		bool unchanged = entries_.read([&](const entries& e) {
+			auto it = e.key_of_object.find(&object);
+			return it != e.key_of_object.end() && it->second == key;
+			});
+		if (unchanged)
+			return;
+
+		entries_.write([&](entries& e) {
+			auto [it, inserted] = e.key_of_object.try_emplace(&object, key);
+			if (!inserted)
+			{
+				auto [first, last] = e.by_key.equal_range(it->second);
+				for (; first != last; ++first)
+				{
+					if (first->second.object() == &object)
+					{
+						e.by_key.erase(first);
+						break;
+					}
+				}
+				it->second = key;
+			}
+			e.by_key.emplace(std::move(key), handle);
+			});
+	}
+
+	// find()
+	// 
+	// Returns the handles of the objects whose last committed key is key
+	std::vector<handle_type> find(const Key& key) const
+	{
+		return entries_.read([&](const entries& e) {
+			auto [first, last] = e.by_key.equal_range(key);
+			std::vector<handle_type> found;
+			for (; first != last; ++first)
+				found.push_back(first->second);
+			return found;
+			});
+	}
+
+	// find_shared()
+	// 
+	// Returns a shared_guard of an object with the given key, or an empty
+	// optional if there is none
+	auto find_shared(const Key& key) const requires SharedLockable<L>
+	{
+		for (const handle_type& handle : find(key))
+		{
+			// guards can't be moved, the lock is adopted by the returned one
+			handle.mutex()->lock_shared();
+			if (has_key(*handle.object(), key))
+				return std::optional<shared_guard<Base, L>>(std::in_place, *handle.mutex(), *handle.object(), std::adopt_lock);
+			handle.mutex()->unlock_shared();
+		}
+		return std::optional<shared_guard<Base, L>>();
+	}
+
+	// find_unique()
+	// 
+	// Returns an indexed_guard of an object with the given key, or an empty
+	// optional if there is none. Key changes through the guard are indexed.
+	std::optional<indexed_guard<Base, L>> find_unique(const Key& key) const
+	{
+		for (const handle_type& handle : find(key))
+		{
+			handle.mutex()->lock();
+			if (has_key(*handle.object(), key))
+				return std::optional<indexed_guard<Base, L>>(std::in_place, handle, indexes_, std::adopt_lock);
+			handle.mutex()->unlock();
+		}
+		return std::optional<indexed_guard<Base, L>>();
+	}
+};
+
+// indexed_guard<Base, L>
+// 
+// Exclusive guard returned by protected_registry::get_unique() and
+// registry_index::find_unique(). When it is released it updates the
+// secondary indexes of the registry with the new keys of the object and
+// then unlocks it.
+// Updating an index allocates. commit() does the update and the unlock and
+// lets a failure (e.g. std::bad_alloc) propagate with the object still
+// locked. The destructor commits as well but can't throw, if the update
+// fails there the key change is not indexed until the next indexed_guard
+// or protected_registry::reindex().
+// All functions of the object can be called via ->
+template<typename Base, typename L>
+requires Lockable<L>
+class indexed_guard
+{
+	std::unique_lock<L> lock_;
+	protected_handle<Base, L> handle_;
+	const registry_index_list<Base, L>& indexes_;
+
+	indexed_guard(const indexed_guard& other) = delete;
+	indexed_guard& operator=(const indexed_guard& other) = delete;
+
+public:
+	indexed_guard(const protected_handle<Base, L>& handle, const registry_index_list<Base, L>& indexes)
+		: lock_(*handle.mutex()), handle_(handle), indexes_(indexes) {};
+	indexed_guard(const protected_handle<Base, L>& handle, const registry_index_list<Base, L>& indexes, std::adopt_lock_t)
+		: lock_(*handle.mutex(), std::adopt_lock), handle_(handle), indexes_(indexes) {};
+
+	~indexed_guard()
+	{
+		if (!lock_.owns_lock())
+			return;
+		try
+		{
+			for (const auto& index : indexes_)
+				index->update(handle_, *handle_.object());
+		}
+		catch (...)
+		{
+		}
+	}
+
+	// commit()
+	// 
+	// Updates the indexes and unlocks the object, the guard can't be used
+	// afterwards. If an update throws the object stays locked.
+	void commit()
+	{
+		for (const auto& index : indexes_)
+			index->update(handle_, *handle_.object());
+		lock_.unlock();
+	}
+
+	Base& operator*()
+	{
+		return *handle_.object();
+	}
+
+	Base* operator->()
+	{
+		return handle_.object();
+	}
+};
+
+// protected_registry<Base, M, Policies...>
+// 
+// Base : common base type of the registered objects
+// M : mutex type
+// Policies : policies of the stored protected_data
+// 
+// Registry of protected objects partitioned into buckets by their dynamic
+// type, which is known at insertion time since the registry constructs the
+// objects. Each bucket is a homogeneous poly_vector<Derived, M>, so a typed
+// scan with for_each<Derived>() walks dense storage of protected_data<Derived, M>
+// and never casts. The base typed view over all buckets is kept in insertion
+// order and is available via at() and for_each().
+// Typed scans match the exact dynamic type, objects of classes derived from
+// Derived live in their own buckets.
+// Secondary indexes added with add_index() find objects by key without a
+// scan, they follow changes made through indexed_guards (get_unique() of the
+// registry, find_unique() of an index) and reindex().
+template<typename Base, typename M, typename... Policies>
+requires Lockable<M>
+class protected_registry
+{
+public:
+	using lock_type = protected_lock_t<M, Policies...>;
+	using handle_type = protected_handle<Base, lock_type>;
+
+private:
+
+	struct bucket_base
+	{
+		virtual ~bucket_base() = default;
+	};
+
+	template<typename Derived>
+	struct bucket : bucket_base
+	{
+		poly_vector<Derived, M, Policies...> items;
+	};
+
+	std::unordered_map<std::type_index, std::unique_ptr<bucket_base>> buckets_;
+	std::vector<handle_type> entries_;
+	registry_index_list<Base, lock_type> indexes_;
+
+	protected_registry(const protected_registry& other) = delete;
+	protected_registry& operator=(const protected_registry& other) = delete;
+
+	template<typename Derived>
+	bucket<Derived>* find_bucket() const
+	{
+		auto it = buckets_.find(std::type_index(typeid(Derived)));
+		if (it == buckets_.end())
+			return nullptr;
+		return static_cast<bucket<Derived>*>(it->second.get());
+	}
+
+	void update_indexes(const handle_type& handle)
+	{
+		std::unique_lock<lock_type> lock(*handle.mutex());
+		for (const auto& index : indexes_)
+			index->update(handle, *handle.object());
+	}
+
+public:
+	protected_registry() = default;
+
+	// emplace<Derived>()
+	// 
+	// Constructs a protected_data<Derived, M, Policies...> in the bucket of Derived
+	// and returns a handle viewing it as Base
+	template<typename Derived, typename... Args>
+	requires std::convertible_to<Derived*, Base*>
+	handle_type emplace(Args&&... args)
+	{
+		auto& slot = buckets_[std::type_index(typeid(Derived))];
+		if (!slot)
+			slot = std::make_unique<bucket<Derived>>();
+
+		auto& items = static_cast<bucket<Derived>*>(slot.get())->items;
+		handle_type handle = items.template emplace<Derived>(std::forward<Args>(args)...);
+		entries_.push_back(handle);
+		if (!indexes_.empty())
+			update_indexes(handle);
+		return handle;
+	}
+
+	// add_index<Key>()
+	// 
+	// Adds a secondary index on Key(key_of(object)) covering the objects
+	// already in the registry and all later ones, returns a reference to it
+	// that is valid as long as the registry
+	template<typename Key, typename KeyOf>
+	requires std::invocable<const KeyOf&, const Base&>
+	registry_index<Base, lock_type, Key, KeyOf>& add_index(KeyOf key_of)
+	{
+		auto created = std::make_unique<registry_index<Base, lock_type, Key, KeyOf>>(std::move(key_of), indexes_);
+		auto& ref = *created;
+		indexes_.push_back(std::move(created));
+		for (const handle_type& handle : entries_)
+		{
+			std::unique_lock<lock_type> lock(*handle.mutex());
+			ref.update(handle, *handle.object());
+		}
+		return ref;
+	}
+
+	// get_unique()
+	// 
+	// Locks the object of handle and returns an indexed_guard, which updates
+	// the secondary indexes when it is released
+	indexed_guard<Base, lock_type> get_unique(const handle_type& handle) const
+	{
+		return indexed_guard<Base, lock_type>(handle, indexes_);
+	}
+
+	// reindex()
+	// 
+	// Locks the object of handle and updates the secondary indexes, for
+	// key changes made through guards that are not indexed_guards
+	void reindex(const handle_type& handle)
+	{
+		update_indexes(handle);
+	}
+
+	std::size_t size() const
+	{
+		return entries_.size();
+	}
+
+	// count<Derived>()
+	// 
+	// Returns the number of objects whose dynamic type is exactly Derived
+	template<typename Derived>
+	std::size_t count() const
+	{
+		auto* b = find_bucket<Derived>();
+		return b ? b->items.size() : 0;
+	}
+
+	// at()
+	// 
+	// Returns the handle of the object inserted at index, or an empty handle
+	handle_type at(std::size_t index) const
+	{
+		if (index < entries_.size())
+			return entries_[index];
+		else
+			return {};
+	}
+
+	// for_each()
+	// 
+	// Calls f with a protected_handle<Base, lock_type> of every object in insertion order
+	template<typename F>
+	void for_each(F&& f) const
+	{
+		for (const handle_type& handle : entries_)
+			f(handle);
+	}
+
+	// for_each<Derived>()
+	// 
+	// Calls f with a protected_handle<Derived, lock_type> of every object whose dynamic
+	// type is exactly Derived, without any dynamic_cast
+	template<typename Derived, typename F>
+	void for_each(F&& f) const
+	{
+		if (auto* b = find_bucket<Derived>())
+			b->items.for_each(std::forward<F>(f));
+	}
+};
+#endif
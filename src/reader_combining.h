@@ -0,0 +1,193 @@
+#ifndef READER_COMBINING
+#define READER_COMBINING
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "protected_data.h"
+
+// reader_combining<M>
+// 
+// M : underlying SharedLockable mutex type
+// 
+// Combines readers that arrive together into batches that share a single
+// lock_shared() of M. The first reader of a batch becomes its leader and
+// acquires the shared lock, readers that arrive while the leader is still
+// acquiring join the batch with one compare-exchange on the combining word
+// and sleep until the leader publishes the grant. Once the lock is acquired
+// the batch is closed and later readers form the next one, so waiting writers
+// of M are not starved. The shared lock of M is always released by the
+// leader, the thread that acquired it, so M may keep per-thread state
+// (e.g. asymmetric_shared_mutex, reentrant or sampled stats). If the leader
+// unlocks before the other members, its unlock_shared() waits until they
+// have left. A member must therefore not wait for the leader of its batch,
+// e.g. for a lock that the leader thread takes before it releases this one.
+// 
+// Meant for hot objects where bursts of readers wake up at once, e.g. after
+// a write. A lone reader pays a few extra atomic operations.
+// Exclusive locking goes to M unchanged.
+// 
+// e.g. protected_data<Config, reader_combining<std::shared_mutex>>
+template<typename M>
+requires SharedLockable<M>
+class reader_combining
+{
+	static constexpr std::uint32_t batch_slots = 4;
+
+	struct alignas(cache_line_size) batch
+	{
+		// generation + 1 of the last batch that used this slot and got the lock
+		std::atomic<std::uint32_t> granted{ 0 };
+		// members that still hold the combined shared lock, the leader included
+		std::atomic<std::uint32_t> remaining{ 0 };
+	};
+
+	// shared locks held by the current thread, with the batch they belong to
+	struct held_lock
+	{
+		const void* lock;
+		batch* combined;
+		bool leader;
+	};
+
+	static inline thread_local std::vector<held_lock> held_;
+
+	M mutex_;
+	// high 32 bits: generation of the forming batch,
+	// low 32 bits: members that joined it, 0 if no batch is forming
+	alignas(cache_line_size) std::atomic<std::uint64_t> forming_{ 0 };
+	batch batches_[batch_slots];
+
+	reader_combining(const reader_combining& other) = delete;
+	reader_combining& operator=(const reader_combining& other) = delete;
+
+	batch& slot_of(std::uint32_t generation)
+	{
+		return batches_[generation % batch_slots];
+	}
+
+	// the previous batch in the slot of generation has been granted and fully
+	// released, it can't change afterwards until generation is granted
+	bool slot_free(std::uint32_t generation)
+	{
+		batch& b = slot_of(generation);
+		return b.granted.load(std::memory_order_acquire) == generation - batch_slots + 1
+			&& b.remaining.load(std::memory_order_acquire) == 0;
+	}
+
+	void lead(std::uint32_t generation)
+	{
+		batch& b = slot_of(generation);
+		mutex_.lock_shared();
+
+		// close the batch, readers arriving from now on start the next one
+		std::uint64_t w = forming_.exchange(std::uint64_t(generation + 1) << 32, std::memory_order_acq_rel);
+		b.remaining.store(static_cast<std::uint32_t>(w), std::memory_order_relaxed);
+		b.granted.store(generation + 1, std::memory_order_release);
+		b.granted.notify_all();
+		held_.push_back({ this, &b, true });
+	}
+
+	void follow(std::uint32_t generation)
+	{
+		batch& b = slot_of(generation);
+		for (std::uint32_t g; (g = b.granted.load(std::memory_order_acquire)) != generation + 1; )
+			b.granted.wait(g, std::memory_order_acquire);
+		held_.push_back({ this, &b, false });
+	}
+
+public:
+	reader_combining()
+	{
+		for (std::uint32_t i = 0; i < batch_slots; ++i)
+			batches_[i].granted.store(i - batch_slots + 1, std::memory_order_relaxed);
+	}
+
+	void lock()
+	{
+		mutex_.lock();
+	}
+
+	bool try_lock() requires requires(M m) { { m.try_lock() } -> std::convertible_to<bool>; }
+	{
+		return mutex_.try_lock();
+	}
+
+	void unlock()
+	{
+		mutex_.unlock();
+	}
+
+	void lock_shared()
+	{
+		std::uint64_t w = forming_.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			std::uint32_t generation = static_cast<std::uint32_t>(w >> 32);
+			// a long held batch, possibly held by this thread, occupies the
+			// slot, don't wait for it and lock without combining
+			if (static_cast<std::uint32_t>(w) == 0 && !slot_free(generation))
+			{
+				mutex_.lock_shared();
+				held_.push_back({ this, nullptr, false });
+				return;
+			}
+			std::uint64_t desired = static_cast<std::uint32_t>(w) == 0 ? (std::uint64_t(generation) << 32) | 1 : w + 1;
+			if (forming_.compare_exchange_weak(w, desired, std::memory_order_acquire, std::memory_order_relaxed))
+			{
+				if (static_cast<std::uint32_t>(w) == 0)
+					lead(generation);
+				else
+					follow(generation);
+				return;
+			}
+		}
+	}
+
+	// does not combine, a failed attempt must not block the batch
+	bool try_lock_shared() requires requires(M m) { { m.try_lock_shared() } -> std::convertible_to<bool>; }
+	{
+		if (!mutex_.try_lock_shared())
+			return false;
+		held_.push_back({ this, nullptr, false });
+		return true;
+	}
+
+	void unlock_shared()
+	{
+		held_lock held{ nullptr, nullptr, false };
+		for (auto it = held_.end(); it != held_.begin(); )
+		{
+			if ((--it)->lock == this)
+			{
+				held = *it;
+				held_.erase(it);
+				break;
+			}
+		}
+		if (!held.combined)
+		{
+			mutex_.unlock_shared();
+			return;
+		}
+
+		batch& b = *held.combined;
+		if (!held.leader)
+		{
+			// the leader waits for the count to drop to its own membership
+			if (b.remaining.fetch_sub(1, std::memory_order_release) == 2)
+				b.remaining.notify_all();
+			return;
+		}
+
+		// acquire: the reads of the members happen before the release of M
+		for (std::uint32_t r; (r = b.remaining.load(std::memory_order_acquire)) != 1; )
+			b.remaining.wait(r, std::memory_order_acquire);
+		mutex_.unlock_shared();
+		// the slot can be reused by a later batch
+		b.remaining.store(0, std::memory_order_release);
+	}
+};
+#endif
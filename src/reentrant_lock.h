@@ -0,0 +1,114 @@
+#ifndef REENTRANT_LOCK
+#define REENTRANT_LOCK
+
+#include <atomic>
+#include <thread>
+
+#include "protected_data.h"
+
+// reentrant<M>
+// 
+// M : underlying mutex type
+// 
+// Reentrancy policy for protected_data. A thread that already holds the
+// exclusive lock can call get_unique() or get_shared() again and gets a
+// nested guard. Ownership is checked with a thread id compare and counted
+// with a depth counter, nested acquisitions never touch the underlying mutex.
+// Unlike std::recursive_mutex it keeps shared locking when M is SharedLockable.
+// A thread holding only a shared lock must not request the exclusive lock.
+// 
+// e.g. protected_data<Square, reentrant<std::shared_mutex>>
+template<typename M>
+requires Lockable<M>
+class reentrant
+{
+	M mutex_;
+	// written only by the owning thread, a relaxed load can only observe
+	// the id of the current thread if the current thread stored it
+	std::atomic<std::thread::id> owner_;
+	unsigned int depth_ = 0;
+
+	reentrant(const reentrant& other) = delete;
+	reentrant& operator=(const reentrant& other) = delete;
+
+	bool owned_by_this_thread() const
+	{
+		return owner_.load(std::memory_order_relaxed) == std::this_thread::get_id();
+	}
+
+	void acquired()
+	{
+		owner_.store(std::this_thread::get_id(), std::memory_order_relaxed);
+		depth_ = 1;
+	}
+
+	bool release_nested()
+	{
+		if (--depth_ != 0)
+			return true;
+		owner_.store(std::thread::id(), std::memory_order_relaxed);
+		return false;
+	}
+
+public:
+	reentrant() = default;
+
+	void lock()
+	{
+		if (owned_by_this_thread())
+		{
+			++depth_;
+			return;
+		}
+		mutex_.lock();
+		acquired();
+	}
+
+	bool try_lock() requires requires(M m) { { m.try_lock() } -> std::convertible_to<bool>; }
+	{
+		if (owned_by_this_thread())
+		{
+			++depth_;
+			return true;
+		}
+		if (!mutex_.try_lock())
+			return false;
+		acquired();
+		return true;
+	}
+
+	void unlock()
+	{
+		if (!release_nested())
+			mutex_.unlock();
+	}
+
+	// a shared acquisition by the exclusive owner is counted as a nested
+	// exclusive one, otherwise it goes to the underlying shared lock
+	void lock_shared() requires SharedLockable<M>
+	{
+		if (owned_by_this_thread())
+		{
+			++depth_;
+			return;
+		}
+		mutex_.lock_shared();
+	}
+
+	void unlock_shared() requires SharedLockable<M>
+	{
+		if (owned_by_this_thread())
+			unlock();
+		else
+			mutex_.unlock_shared();
+	}
+
+	// held_by_this_thread()
+	// 
+	// Returns whether the calling thread holds the exclusive lock
+	bool held_by_this_thread() const
+	{
+		return owned_by_this_thread();
+	}
+};
+#endif
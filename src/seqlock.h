@@ -0,0 +1,230 @@
+#ifndef SEQLOCK
+#define SEQLOCK
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <type_traits>
+
+#include "protected_data.h"
+#include "spin_lock.h"
+
+// seqlock_cell<T>
+// 
+// T : trivially copyable object type
+// 
+// Storage of a seqlock: a sequence counter and the object bytes kept in
+// relaxed atomic words, so optimistic readers racing with a writer never
+// cause a data race, they just retry. The sequence is odd while a write
+// is in progress, the version of a value is sequence / 2.
+// Writers must be serialized by the owner of the cell.
+// All members are lock-free and address-free, so a cell can also be
+// placed in memory shared between processes.
+template<typename T>
+requires std::is_trivially_copyable_v<T>
+class seqlock_cell
+{
+	static constexpr std::size_t words = (sizeof(T) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+
+	static_assert(std::atomic<std::uint64_t>::is_always_lock_free);
+
+	std::atomic<std::uint64_t> sequence_{ 0 };
+	std::atomic<std::uint64_t> data_[words];
+
+	void store_data(const T& value)
+	{
+		std::uint64_t buffer[words] = {};
+		std::memcpy(buffer, &value, sizeof(T));
+		for (std::size_t i = 0; i < words; ++i)
+			data_[i].store(buffer[i], std::memory_order_relaxed);
+	}
+
+	bool try_load_bytes(std::array<std::byte, sizeof(T)>& out, std::uint64_t& version) const
+	{
+		std::uint64_t before = sequence_.load(std::memory_order_acquire);
+		if (before & 1)
+			return false;
+
+		std::uint64_t buffer[words];
+		for (std::size_t i = 0; i < words; ++i)
+			buffer[i] = data_[i].load(std::memory_order_relaxed);
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (sequence_.load(std::memory_order_relaxed) != before)
+			return false;
+
+		std::memcpy(out.data(), buffer, sizeof(T));
+		version = before / 2;
+		return true;
+	}
+
+public:
+	explicit seqlock_cell(const T& value)
+	{
+		for (auto& word : data_)
+			word.store(0, std::memory_order_relaxed);
+		store_data(value);
+	}
+
+	seqlock_cell(const seqlock_cell& other) = delete;
+	seqlock_cell& operator=(const seqlock_cell& other) = delete;
+
+	// try_load()
+	// 
+	// Makes a single read attempt, returns false if a write was in progress
+	// or happened during the copy
+	bool try_load(T& out, std::uint64_t& version) const
+	{
+		std::array<std::byte, sizeof(T)> bytes;
+		if (!try_load_bytes(bytes, version))
+			return false;
+		std::memcpy(&out, bytes.data(), sizeof(T));
+		return true;
+	}
+
+	// load()
+	// 
+	// Retries until a consistent copy is read
+	T load(std::uint64_t* version = nullptr) const
+	{
+		std::array<std::byte, sizeof(T)> bytes;
+		std::uint64_t v;
+		while (!try_load_bytes(bytes, v))
+			spin_lock::pause();
+		if (version)
+			*version = v;
+		return std::bit_cast<T>(bytes);
+	}
+
+	std::uint64_t version() const
+	{
+		return sequence_.load(std::memory_order_acquire) / 2;
+	}
+
+	// store()
+	// 
+	// Publishes a new value, concurrent readers retry. An odd sequence left
+	// by a writer process that died inside store() is completed by the next one.
+	void store(const T& value)
+	{
+		std::uint64_t sequence = sequence_.load(std::memory_order_relaxed) & ~std::uint64_t(1);
+		sequence_.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		store_data(value);
+		sequence_.store(sequence + 2, std::memory_order_release);
+	}
+};
+
+// seqlock_unique_guard<T, W>
+// 
+// T : contained object type
+// W : writer lock type
+// 
+// Exclusive guard of a seqlock_protected. Works on a private copy of the
+// object while holding the writer lock and publishes it on destruction, so
+// readers only retry during the final copy, not during the whole guard.
+template<typename T, typename W>
+class seqlock_unique_guard
+{
+	std::unique_lock<W> lock_;
+	seqlock_cell<T>& cell_;
+	T object_;
+
+	seqlock_unique_guard(const seqlock_unique_guard& other) = delete;
+	seqlock_unique_guard& operator=(const seqlock_unique_guard& other) = delete;
+
+public:
+	seqlock_unique_guard(W& writer, seqlock_cell<T>& cell) : lock_(writer), cell_(cell), object_(cell.load()) {};
+
+	~seqlock_unique_guard()
+	{
+		cell_.store(object_);
+	}
+
+	T& operator*()
+	{
+		return object_;
+	}
+
+	T* operator->()
+	{
+		return &object_;
+	}
+};
+
+// seqlock_protected<T, W>
+// 
+// T : trivially copyable object type
+// W : lock type serializing the writers
+// 
+// Read-mostly alternative to protected_data for small trivially copyable
+// objects. Readers never write to shared memory: get_shared() and read(f)
+// work on a validated copy and retry if a writer interfered.
+// Writers are serialized by W and invalidate the readers with the sequence.
+template<typename T, typename W = spin_lock>
+requires std::is_trivially_copyable_v<T> && Lockable<W>
+class seqlock_protected
+{
+	seqlock_cell<T> cell_;
+	W writer_;
+
+	seqlock_protected(const seqlock_protected& other) = delete;
+	seqlock_protected& operator=(const seqlock_protected& other) = delete;
+
+public:
+	using value_type = T;
+
+	template<typename... Args>
+	seqlock_protected(Args&&... args) : cell_(T(std::forward<Args>(args)...)) {};
+
+	// get_unique()
+	// 
+	// Acquires the writer lock and returns a guard of a private copy,
+	// the copy is published when the guard is destroyed
+	seqlock_unique_guard<T, W> get_unique()
+	{
+		return seqlock_unique_guard<T, W>(writer_, cell_);
+	}
+
+	// get_shared()
+	// 
+	// Returns a snapshot_guard with a consistent copy, never blocks writers
+	snapshot_guard<T> get_shared() const
+	{
+		return snapshot_guard<T>(cell_.load());
+	}
+
+	// read(f)
+	// 
+	// Calls f with a consistent copy and returns the result of f by value
+	template<typename F>
+	auto read(F&& f) const
+	{
+		const T copy = cell_.load();
+		return std::invoke(std::forward<F>(f), copy);
+	}
+
+	// write(f)
+	// 
+	// Calls f with a private copy under the writer lock, then publishes it
+	template<typename F>
+	auto write(F&& f)
+	{
+		auto guard = get_unique();
+		return std::invoke(std::forward<F>(f), *guard);
+	}
+
+	// version()
+	// 
+	// Number of completed writes
+	std::uint64_t version() const
+	{
+		return cell_.version();
+	}
+};
+#endif
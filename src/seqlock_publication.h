@@ -0,0 +1,302 @@
+#ifndef SEQLOCK_PUBLICATION
+#define SEQLOCK_PUBLICATION
+
+#if defined(__unix__)
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "protected_data.h"
+#include "seqlock.h"
+#include "spin_lock.h"
+
+// ----- Cross-process publication of a trivially copyable object
+// 
+// A seqlock_publisher<T> process writes T into a seqlock_cell<T> placed in a
+// file mapped with MAP_SHARED, any number of seqlock_subscriber<T> processes
+// map the same file read-only and take validated copies. Reads are a few
+// loads from the shared pages, no system call and no write to shared memory.
+// 
+// There is a single writer process, enforced with an exclusive flock() on
+// the file that the kernel drops when the publisher exits, so no robust mutex
+// is needed. If a publisher dies in the middle of a write, readers retry until
+// the next publisher on the file completes the sequence with its initial
+// value. If it dies while creating the file, before the magic is stored,
+// subscribers refuse the file and the next publisher creates it again.
+// T must not contain pointers or other process local state.
+// 
+// e.g.
+// publisher : seqlock_publisher<Routes> routes("/dev/shm/routes", initial);
+//             routes.publish(updated);
+// workers   : seqlock_subscriber<Routes> routes("/dev/shm/routes");
+//             auto guard = routes.get_shared();
+
+// seqlock_publication_region<T>
+// 
+// Layout of the mapped file. The header identifies the layout, magic is
+// stored last by the publisher that creates the file. A file whose magic
+// is 0 was never completely initialized.
+template<typename T>
+struct seqlock_publication_region
+{
+	static constexpr std::uint64_t expected_magic = 0x73716c6f636b7075; // "sqlockpu"
+	static_assert(sizeof(std::atomic<std::uint64_t>) == sizeof(std::uint64_t));
+
+	std::atomic<std::uint64_t> magic;
+	std::uint64_t object_size;
+	std::uint64_t object_alignment;
+	alignas(cache_line_size) seqlock_cell<T> cell;
+
+	bool matches() const
+	{
+		return magic.load(std::memory_order_acquire) == expected_magic
+			&& object_size == sizeof(T) && object_alignment == alignof(T);
+	}
+};
+
+inline void* seqlock_publication_map(int fd, std::size_t size, int protection)
+{
+	void* p = ::mmap(nullptr, size, protection, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED)
+		throw std::system_error(errno, std::system_category(), "mmap");
+	return p;
+}
+
+// closes fd and throws a system_error for error
+inline void seqlock_publication_fail(int fd, const char* what, int error = errno)
+{
+	::close(fd);
+	throw std::system_error(error, std::system_category(), what);
+}
+
+// seqlock_publisher<T>
+// 
+// T : trivially copyable object type
+// 
+// Creates or reopens the publication file, publishes the initial value and
+// holds the file as its single writer until destroyed. Throws
+// std::system_error if the file can't be set up or another publisher holds
+// it, std::runtime_error if the file contains a publication of another layout.
+// Threads of the publisher process are serialized by a spin_lock.
+template<typename T>
+requires std::is_trivially_copyable_v<T>
+class seqlock_publisher
+{
+	using region_type = seqlock_publication_region<T>;
+
+	int fd_ = -1;
+	region_type* region_ = nullptr;
+	spin_lock writer_;
+
+	seqlock_publisher(const seqlock_publisher& other) = delete;
+	seqlock_publisher& operator=(const seqlock_publisher& other) = delete;
+
+public:
+	using value_type = T;
+
+	seqlock_publisher(const char* path, const T& initial = T(), mode_t mode = 0644)
+	{
+		fd_ = ::open(path, O_RDWR | O_CREAT | O_CLOEXEC, mode);
+		if (fd_ < 0)
+			throw std::system_error(errno, std::system_category(), std::string("open ") + path);
+		if (::flock(fd_, LOCK_EX | LOCK_NB) != 0)
+			seqlock_publication_fail(fd_, errno == EWOULDBLOCK ? "another seqlock_publisher holds the file" : "flock");
+
+		struct stat st;
+		if (::fstat(fd_, &st) != 0)
+			seqlock_publication_fail(fd_, "fstat");
+
+		// magic is the first word of the file, a new file or one left by a
+		// publisher that died during its creation has none and is created again
+		std::uint64_t magic = 0;
+		ssize_t n = ::pread(fd_, &magic, sizeof(magic), 0);
+		if (n < 0)
+			seqlock_publication_fail(fd_, "pread");
+		bool created = n != sizeof(magic) || magic == 0;
+		if (created && static_cast<std::size_t>(st.st_size) != sizeof(region_type) && ::ftruncate(fd_, sizeof(region_type)) != 0)
+			seqlock_publication_fail(fd_, "ftruncate");
+		if (!created && static_cast<std::size_t>(st.st_size) < sizeof(region_type))
+		{
+			::close(fd_);
+			throw std::runtime_error(std::string(path) + " holds a publication of another layout");
+		}
+
+		try
+		{
+			region_ = static_cast<region_type*>(seqlock_publication_map(fd_, sizeof(region_type), PROT_READ | PROT_WRITE));
+		}
+		catch (...)
+		{
+			::close(fd_);
+			throw;
+		}
+
+		if (created)
+		{
+			// construct before marking the file valid, the cell constructor
+			// overwrites whatever a dead publisher left in it
+			::new (&region_->cell) seqlock_cell<T>(initial);
+			region_->object_size = sizeof(T);
+			region_->object_alignment = alignof(T);
+			region_->magic.store(region_type::expected_magic, std::memory_order_release);
+		}
+		else if (!region_->matches())
+		{
+			::munmap(region_, sizeof(region_type));
+			::close(fd_);
+			throw std::runtime_error(std::string(path) + " holds a publication of another layout");
+		}
+		else
+			region_->cell.store(initial);
+	}
+
+	~seqlock_publisher()
+	{
+		::munmap(region_, sizeof(region_type));
+		// releases the flock
+		::close(fd_);
+	}
+
+	// publish()
+	// 
+	// Stores value, subscribers see it on their next read
+	void publish(const T& value)
+	{
+		std::lock_guard lk(writer_);
+		region_->cell.store(value);
+	}
+
+	// get_unique()
+	// 
+	// Returns a guard of a private copy of the current value, the copy is
+	// published when the guard is destroyed
+	seqlock_unique_guard<T, spin_lock> get_unique()
+	{
+		return seqlock_unique_guard<T, spin_lock>(writer_, region_->cell);
+	}
+
+	// write(f)
+	// 
+	// Calls f with a copy of the current value, then publishes it
+	template<typename F>
+	auto write(F&& f)
+	{
+		auto guard = get_unique();
+		return std::invoke(std::forward<F>(f), *guard);
+	}
+
+	// version()
+	// 
+	// Number of completed writes
+	std::uint64_t version() const
+	{
+		return region_->cell.version();
+	}
+};
+
+// seqlock_subscriber<T>
+// 
+// T : trivially copyable object type, the same as the publisher's
+// 
+// Maps an existing publication file read-only. Throws std::system_error if
+// the file can't be opened or mapped, std::runtime_error if it is not yet
+// initialized or holds another layout; callers starting before the
+// publisher retry.
+template<typename T>
+requires std::is_trivially_copyable_v<T>
+class seqlock_subscriber
+{
+	using region_type = seqlock_publication_region<T>;
+
+	const region_type* region_ = nullptr;
+
+	seqlock_subscriber(const seqlock_subscriber& other) = delete;
+	seqlock_subscriber& operator=(const seqlock_subscriber& other) = delete;
+
+public:
+	using value_type = T;
+
+	explicit seqlock_subscriber(const char* path)
+	{
+		int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			throw std::system_error(errno, std::system_category(), std::string("open ") + path);
+
+		struct stat st;
+		if (::fstat(fd, &st) != 0)
+			seqlock_publication_fail(fd, "fstat");
+		if (static_cast<std::size_t>(st.st_size) < sizeof(region_type))
+		{
+			::close(fd);
+			throw std::runtime_error(std::string(path) + " is not an initialized publication");
+		}
+
+		void* p;
+		try
+		{
+			p = seqlock_publication_map(fd, sizeof(region_type), PROT_READ);
+		}
+		catch (...)
+		{
+			::close(fd);
+			throw;
+		}
+		// the mapping stays valid without the descriptor
+		::close(fd);
+
+		region_ = static_cast<const region_type*>(p);
+		if (!region_->matches())
+		{
+			::munmap(p, sizeof(region_type));
+			throw std::runtime_error(std::string(path) + " is not an initialized publication of this type");
+		}
+	}
+
+	~seqlock_subscriber()
+	{
+		::munmap(const_cast<region_type*>(region_), sizeof(region_type));
+	}
+
+	// get_shared()
+	// 
+	// Returns a snapshot_guard with a consistent copy of the published value
+	snapshot_guard<T> get_shared() const
+	{
+		return snapshot_guard<T>(region_->cell.load());
+	}
+
+	// read(f)
+	// 
+	// Calls f with a consistent copy and returns the result of f by value
+	template<typename F>
+	auto read(F&& f) const
+	{
+		const T copy = region_->cell.load();
+		return std::invoke(std::forward<F>(f), copy);
+	}
+
+	// version()
+	// 
+	// Number of completed writes, lets subscribers skip unchanged values
+	std::uint64_t version() const
+	{
+		return region_->cell.version();
+	}
+};
+
+#endif
+#endif
@@ -0,0 +1,63 @@
+#ifndef SPIN_LOCK
+#define SPIN_LOCK
+
+#include <atomic>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// spin_lock
+// 
+// Test and test-and-set spin lock for short critical sections.
+// Waiters spin on a plain load so the lock word stays shared in their caches
+// while it is held, and yield to the scheduler after a while.
+// Exclusive only, fits in a single byte.
+// 
+// e.g. protected_data<Point, spin_lock, cache_aligned>
+class spin_lock
+{
+	std::atomic<bool> locked_{ false };
+
+	spin_lock(const spin_lock& other) = delete;
+	spin_lock& operator=(const spin_lock& other) = delete;
+
+public:
+	spin_lock() = default;
+
+	// pause()
+	// 
+	// Spin-wait hint for the processor
+	static void pause()
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		_mm_pause();
+#endif
+	}
+
+	void lock()
+	{
+		for (unsigned int spins = 0; locked_.exchange(true, std::memory_order_acquire); )
+		{
+			while (locked_.load(std::memory_order_relaxed))
+			{
+				if (++spins < 128)
+					pause();
+				else
+					std::this_thread::yield();
+			}
+		}
+	}
+
+	bool try_lock()
+	{
+		return !locked_.load(std::memory_order_relaxed) && !locked_.exchange(true, std::memory_order_acquire);
+	}
+
+	void unlock()
+	{
+		locked_.store(false, std::memory_order_release);
+	}
+};
+#endif
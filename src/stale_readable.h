@@ -0,0 +1,119 @@
+#ifndef STALE_READABLE
+#define STALE_READABLE
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "protected_data.h"
+
+// stale_readable<M>
+// 
+// M : underlying shared mutex type
+// 
+// Shared mutex for readers that tolerate slightly outdated data but must
+// never wait behind a slow writer (e.g. dashboards and health checks).
+// The protected_data binds its object on construction, every exclusive
+// unlock then publishes a copy of the object with an incremented version
+// before it releases M. get_shared_or_stale() tries the shared lock and
+// returns the last published copy if a writer holds it.
+// 
+// Every exclusive unlock copies the object into a new allocation, so it is
+// meant for small, rarely written objects. If the copy throws, the previous
+// copy stays published.
+// 
+// e.g.
+// protected_data<HealthStatus, stale_readable<std::shared_mutex>> health;
+// auto guard = health.get_shared_or_stale();
+template<typename M>
+requires SharedLockable<M> && requires(M m) { { m.try_lock_shared() } -> std::convertible_to<bool>; }
+class stale_readable
+{
+	using copy_function = std::shared_ptr<const stale_snapshot_base>(*)(const void*, std::uint64_t);
+
+	M mutex_;
+	const void* object_ = nullptr;
+	copy_function copy_ = nullptr;
+	// written by the exclusive holder, read by stale readers
+	std::atomic<std::shared_ptr<const stale_snapshot_base>> published_;
+	// protected by the exclusive lock
+	std::uint64_t version_ = 0;
+
+	stale_readable(const stale_readable& other) = delete;
+	stale_readable& operator=(const stale_readable& other) = delete;
+
+	template<typename T>
+	static std::shared_ptr<const stale_snapshot_base> copy(const void* object, std::uint64_t version)
+	{
+		return std::make_shared<stale_snapshot<T>>(version, *static_cast<const T*>(object));
+	}
+
+	void publish() noexcept
+	{
+		if (!copy_)
+			return;
+		try
+		{
+			published_.store(copy_(object_, version_ + 1), std::memory_order_release);
+			++version_;
+		}
+		catch (...)
+		{
+		}
+	}
+
+public:
+	stale_readable() = default;
+
+	// bind_object()
+	// 
+	// Called by protected_data with the protected object, publishes its
+	// initial state as version 0
+	template<typename T>
+	void bind_object(const T& object)
+	{
+		object_ = &object;
+		copy_ = &copy<T>;
+		published_.store(copy_(object_, version_), std::memory_order_release);
+	}
+
+	void lock()
+	{
+		mutex_.lock();
+	}
+
+	bool try_lock() requires requires(M m) { { m.try_lock() } -> std::convertible_to<bool>; }
+	{
+		return mutex_.try_lock();
+	}
+
+	void unlock()
+	{
+		publish();
+		mutex_.unlock();
+	}
+
+	void lock_shared()
+	{
+		mutex_.lock_shared();
+	}
+
+	bool try_lock_shared()
+	{
+		return mutex_.try_lock_shared();
+	}
+
+	void unlock_shared()
+	{
+		mutex_.unlock_shared();
+	}
+
+	// published()
+	// 
+	// Returns the copy published at the last exclusive unlock
+	std::shared_ptr<const stale_snapshot_base> published() const
+	{
+		return published_.load(std::memory_order_acquire);
+	}
+};
+#endif
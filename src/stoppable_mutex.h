@@ -0,0 +1,123 @@
+#ifndef STOPPABLE_MUTEX
+#define STOPPABLE_MUTEX
+
+#include <condition_variable>
+#include <mutex>
+#include <stop_token>
+
+#include "protected_data.h"
+
+// stoppable_shared_mutex
+// 
+// Shared mutex whose waits can be interrupted through a std::stop_token.
+// Waiters block on a condition_variable_any, which registers a stop_callback
+// for the duration of the wait, so a stop request wakes them up immediately
+// instead of being noticed by polling. Writers are preferred over new readers.
+// 
+// With protected_data<T, stoppable_shared_mutex> the get_unique(stoken) and
+// get_shared(stoken) overloads return an empty optional once a stop is requested,
+// e.g. from a std::jthread worker during shutdown.
+class stoppable_shared_mutex
+{
+	std::mutex state_mutex_;
+	std::condition_variable_any cv_;
+	unsigned int readers_ = 0;
+	unsigned int waiting_writers_ = 0;
+	bool writer_ = false;
+
+	stoppable_shared_mutex(const stoppable_shared_mutex& other) = delete;
+	stoppable_shared_mutex& operator=(const stoppable_shared_mutex& other) = delete;
+
+	bool can_lock() const
+	{
+		return !writer_ && readers_ == 0;
+	}
+
+	bool can_lock_shared() const
+	{
+		return !writer_ && waiting_writers_ == 0;
+	}
+
+public:
+	stoppable_shared_mutex() = default;
+
+	void lock()
+	{
+		std::unique_lock lk(state_mutex_);
+		++waiting_writers_;
+		cv_.wait(lk, [this] { return can_lock(); });
+		--waiting_writers_;
+		writer_ = true;
+	}
+
+	bool lock(std::stop_token stoken)
+	{
+		std::unique_lock lk(state_mutex_);
+		++waiting_writers_;
+		bool acquired = cv_.wait(lk, stoken, [this] { return can_lock(); });
+		--waiting_writers_;
+		if (!acquired)
+		{
+			// readers may have been held back only by this writer
+			cv_.notify_all();
+			return false;
+		}
+		writer_ = true;
+		return true;
+	}
+
+	bool try_lock()
+	{
+		std::lock_guard lk(state_mutex_);
+		if (!can_lock())
+			return false;
+		writer_ = true;
+		return true;
+	}
+
+	void unlock()
+	{
+		{
+			std::lock_guard lk(state_mutex_);
+			writer_ = false;
+		}
+		cv_.notify_all();
+	}
+
+	void lock_shared()
+	{
+		std::unique_lock lk(state_mutex_);
+		cv_.wait(lk, [this] { return can_lock_shared(); });
+		++readers_;
+	}
+
+	bool lock_shared(std::stop_token stoken)
+	{
+		std::unique_lock lk(state_mutex_);
+		if (!cv_.wait(lk, stoken, [this] { return can_lock_shared(); }))
+			return false;
+		++readers_;
+		return true;
+	}
+
+	bool try_lock_shared()
+	{
+		std::lock_guard lk(state_mutex_);
+		if (!can_lock_shared())
+			return false;
+		++readers_;
+		return true;
+	}
+
+	void unlock_shared()
+	{
+		bool last;
+		{
+			std::lock_guard lk(state_mutex_);
+			last = --readers_ == 0;
+		}
+		if (last)
+			cv_.notify_all();
+	}
+};
+#endif
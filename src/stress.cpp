@@ -0,0 +1,156 @@
+// stress : randomized concurrency gate for the protected_data backends
+//
+// usage: stress [threads] [ops_per_thread] [seed]
+// Runs stress_protected() (stress_check.h) on every backend in the tree and
+// prints one line per backend. Exits with 1 if any history has a torn read,
+// a lost update or is not linearizable, or if the sums of percpu_protected
+// don't match the number of updates.
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "protected_data.h"
+#include "stress_check.h"
+#include "atomic_protected.h"
+#include "auto_protected.h"
+#include "seqlock.h"
+#include "spin_lock.h"
+#include "reentrant_lock.h"
+#include "nested_lock.h"
+#include "stoppable_mutex.h"
+#include "pi_mutex.h"
+#include "asymmetric_shared_mutex.h"
+#include "handoff_mutex.h"
+#include "reader_combining.h"
+#include "freezable.h"
+#include "table_locked.h"
+#include "biased_lock.h"
+#include "stale_readable.h"
+#include "percpu_protected.h"
+
+using namespace std;
+
+// four words so that torn reads and half done writes are visible
+using model = stress_model<4>;
+
+bool failed = false;
+
+template <typename P>
+void run(const string& name, const stress_options& options)
+{
+    auto backend = make_unique<P>();
+    stress_result r = stress_protected(*backend, options);
+    failed = failed || !r.passed();
+
+    cout << left << setw(44) << name << (r.passed() ? "ok    " : "FAILED")
+        << right << setw(10) << r.reads << " reads" << setw(9) << r.writes << " writes"
+        << setw(8) << chrono::duration_cast<chrono::milliseconds>(r.elapsed).count() << " ms";
+    if (r.torn_reads)
+        cout << "  torn reads: " << r.torn_reads;
+    if (r.lost_updates)
+        cout << "  lost updates: " << r.lost_updates;
+    if (!r.violation.empty())
+        cout << "  " << r.violation;
+    cout << endl;
+}
+
+struct percpu_counters
+{
+    uint64_t fast;
+    uint32_t narrow;
+    uint64_t locked;
+};
+
+// per-CPU slots have no linearizable history, the check is that the
+// aggregates equal the number of updates once all threads are joined
+void run_percpu(const stress_options& options)
+{
+    auto counters = make_unique<percpu_protected<percpu_counters>>();
+    const uint64_t initial = counters->sum(&percpu_counters::fast) + counters->sum(&percpu_counters::narrow) + counters->sum(&percpu_counters::locked);
+
+    auto start = chrono::steady_clock::now();
+    vector<thread> threads;
+    for (unsigned int t = 0; t < options.threads; ++t)
+    {
+        threads.emplace_back([&counters, &options, t]() {
+            for (unsigned int i = 0; i < options.ops_per_thread; ++i)
+            {
+                counters->add(&percpu_counters::fast, uint64_t(1));
+                counters->add(&percpu_counters::narrow, uint32_t(1));
+                if ((i + t) % 8 == 0)
+                    counters->write([](percpu_counters& c) { ++c.locked; });
+                if (i % 1024 == 0)
+                    this_thread::yield();
+            }
+            });
+    }
+    for (auto& t : threads)
+        t.join();
+    auto elapsed = chrono::steady_clock::now() - start;
+
+    uint64_t expected = uint64_t(options.threads) * options.ops_per_thread;
+    uint64_t expected_locked = 0;
+    for (unsigned int t = 0; t < options.threads; ++t)
+        for (unsigned int i = 0; i < options.ops_per_thread; ++i)
+            expected_locked += (i + t) % 8 == 0;
+
+    uint64_t fast = counters->sum(&percpu_counters::fast);
+    uint64_t narrow = counters->sum(&percpu_counters::narrow);
+    uint64_t locked = counters->read(uint64_t(0), [](uint64_t total, const percpu_counters& c) { return total + c.locked; });
+    bool passed = initial == 0 && fast == expected && narrow == expected && locked == expected_locked;
+    failed = failed || !passed;
+
+    cout << left << setw(44) << "percpu_protected" << (passed ? "ok    " : "FAILED")
+        << right << setw(10) << expected * 2 + expected_locked << " updates"
+        << setw(8) << chrono::duration_cast<chrono::milliseconds>(elapsed).count() << " ms";
+    if (!passed)
+        cout << "  initial " << initial << ", add " << fast << "/" << narrow << " of " << expected << ", write " << locked << " of " << expected_locked;
+    cout << endl;
+}
+
+int main(int argc, char** argv)
+{
+    stress_options options;
+    if (argc > 1)
+        options.threads = atoi(argv[1]);
+    if (argc > 2)
+        options.ops_per_thread = atoi(argv[2]);
+    if (argc > 3)
+        options.seed = strtoull(argv[3], nullptr, 10);
+
+    cout << options.threads << " threads, " << options.ops_per_thread << " operations per thread, seed " << options.seed << endl;
+
+    run<protected_data<model, mutex>>("mutex", options);
+    run<protected_data<model, shared_mutex>>("shared_mutex", options);
+    run<protected_data<model, shared_mutex, sampled_stats<8>>>("shared_mutex, sampled_stats", options);
+    run<protected_data<model, spin_lock, cache_aligned>>("spin_lock", options);
+    run<protected_data<model, reentrant<shared_mutex>>>("reentrant<shared_mutex>", options);
+    run<protected_data<model, nested_lock<shared_mutex>>>("nested_lock<shared_mutex>", options);
+    run<protected_data<model, stoppable_shared_mutex>>("stoppable_shared_mutex", options);
+    run<protected_data<model, handoff_mutex>>("handoff_mutex", options);
+    run<protected_data<model, asymmetric_shared_mutex>>("asymmetric_shared_mutex", options);
+    run<protected_data<model, reader_combining<shared_mutex>>>("reader_combining<shared_mutex>", options);
+    run<protected_data<model, freezable<shared_mutex>>>("freezable<shared_mutex>", options);
+#if defined(__linux__)
+    run<protected_data<model, pi_mutex>>("pi_mutex", options);
+#endif
+    run<protected_data<model, biased<mutex, 8>>>("biased<mutex>", options);
+    run<protected_data<model, biased<shared_mutex, 8>>>("biased<shared_mutex>", options);
+    run<protected_data<model, stale_readable<shared_mutex>>>("stale_readable<shared_mutex>", options);
+    run<table_locked<model>>("table_locked", options);
+    run<seqlock_protected<model>>("seqlock_protected", options);
+    run<atomic_protected<stress_model<1>>>("atomic_protected", options);
+    // small objects get the seqlock backend, large ones protected_data
+    run<auto_protected<stress_model<1>>>("auto_protected, 8 bytes", options);
+    run<auto_protected<stress_model<64>>>("auto_protected, 512 bytes", options);
+    run_percpu(options);
+
+    return failed ? 1 : 0;
+}
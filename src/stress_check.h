@@ -0,0 +1,306 @@
+#ifndef STRESS_CHECK
+#define STRESS_CHECK
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "spin_lock.h"
+
+// ----- Stress and linearizability check of protected_data backends
+// 
+// stress_protected(backend, options) drives a backend holding a
+// stress_model<Words> from many threads with a random mix of exclusive
+// increments and shared reads, through write(f)/read(f) and, where the
+// backend has them, get_unique()/get_shared(). Every operation is recorded
+// with its invocation and response time and the value it saw, the history
+// is then checked by check_register_history():
+// 
+// - torn reads: a read or write saw words that differ, i.e. a write was
+//   visible only partially or two writers were inside at the same time
+// - lost updates: two increments read the same old value
+// - linearizability: the history of the counter register has a sequential
+//   order consistent with real time, increment v happens after v - 1,
+//   every read returning v lies between increment v and v + 1
+// 
+// e.g.
+// protected_data<stress_model<4>, spin_lock> pd;
+// stress_result r = stress_protected(pd, stress_options{ .threads = 32 });
+
+// stress_model<Words>
+// 
+// Counter stored in Words copies, a consistent state has all copies equal
+template<std::size_t Words>
+struct stress_model
+{
+	static_assert(Words > 0);
+
+	std::uint64_t words[Words] = {};
+
+	bool consistent() const
+	{
+		return std::all_of(words + 1, words + Words, [&](std::uint64_t w) { return w == words[0]; });
+	}
+
+	std::uint64_t value() const
+	{
+		return words[0];
+	}
+
+	void set(std::uint64_t v)
+	{
+		std::fill(words, words + Words, v);
+	}
+};
+
+struct stress_options
+{
+	unsigned int threads = 16;
+	unsigned int ops_per_thread = 20000;
+	// share of the operations that are exclusive increments
+	unsigned int write_percent = 20;
+	// upper bound of the random pause between two operations, in spin iterations
+	unsigned int max_pause = 64;
+	// share of the operations that yield halfway through their critical
+	// section, widens race windows on machines with few cores
+	unsigned int yield_inside_percent = 2;
+	std::uint64_t seed = 1;
+};
+
+// stress_op
+// 
+// Recorded operation, value is the counter after an increment
+// or the counter seen by a read
+struct stress_op
+{
+	std::uint64_t invoked = 0;
+	std::uint64_t responded = 0;
+	std::uint64_t value = 0;
+	bool write = false;
+};
+
+struct stress_result
+{
+	std::uint64_t reads = 0;
+	std::uint64_t writes = 0;
+	std::uint64_t torn_reads = 0;
+	std::uint64_t lost_updates = 0;
+	bool linearizable = true;
+	// description of the first violation found
+	std::string violation;
+	std::chrono::nanoseconds elapsed{ 0 };
+
+	bool passed() const
+	{
+		return torn_reads == 0 && lost_updates == 0 && linearizable;
+	}
+};
+
+// check_register_history()
+// 
+// Checks a history of increments and reads of a counter that started at 0
+// and ended at final_value, fills in the counts and the violation of result.
+// The order of the increments is given by their values, so linearization
+// points can be assigned greedily: each operation as early as allowed by
+// its invocation and by the operations ordered before it.
+inline void check_register_history(std::vector<stress_op> history, std::uint64_t final_value, stress_result& result)
+{
+	auto fail = [&](std::string what) {
+		if (result.linearizable)
+			result.violation = std::move(what);
+		result.linearizable = false;
+	};
+	auto describe = [](const stress_op& op) {
+		return std::string(op.write ? "increment to " : "read of ") + std::to_string(op.value)
+			+ " [" + std::to_string(op.invoked) + ", " + std::to_string(op.responded) + "]";
+	};
+
+	// groups of increment v followed by the reads of v
+	std::sort(history.begin(), history.end(), [](const stress_op& a, const stress_op& b) {
+		return a.value != b.value ? a.value < b.value : a.write > b.write;
+		});
+
+	std::uint64_t writes = 0;
+	for (const stress_op& op : history)
+	{
+		if (op.write)
+			++writes;
+		else
+			++result.reads;
+	}
+	result.writes = writes;
+	if (final_value != writes)
+		fail("final value " + std::to_string(final_value) + " after " + std::to_string(writes) + " increments");
+
+	// earliest linearization point of the next operation
+	std::uint64_t t = 0;
+	std::uint64_t expected_write = 1;
+	for (std::size_t i = 0; i < history.size(); )
+	{
+		const stress_op& op = history[i];
+		if (op.write)
+		{
+			++i;
+			// a duplicate means two increments read the same old value
+			if (op.value < expected_write)
+			{
+				++result.lost_updates;
+				continue;
+			}
+			if (op.value > expected_write)
+				fail("no increment to " + std::to_string(expected_write));
+			expected_write = op.value + 1;
+			t = std::max(t, op.invoked);
+			if (t > op.responded)
+				fail(describe(op) + " completed before an operation ordered before it started");
+			continue;
+		}
+
+		// the reads of a value lie between its increment and the next one,
+		// in any order among themselves
+		const std::uint64_t value = op.value;
+		std::uint64_t latest = t;
+		for (; i < history.size() && !history[i].write && history[i].value == value; ++i)
+		{
+			if (value > writes)
+				fail(describe(history[i]) + " returned a value that was never written");
+			else if (t > history[i].responded)
+				fail(describe(history[i]) + " completed before the increment to " + std::to_string(value) + " could happen");
+			latest = std::max(latest, history[i].invoked);
+		}
+		t = latest;
+	}
+}
+
+// stress_protected()
+// 
+// Runs the randomized concurrent history on backend, which must hold
+// a stress_model<Words> starting at 0, and checks it
+template<typename P>
+stress_result stress_protected(P& backend, const stress_options& options)
+{
+	using model = typename P::value_type;
+	using clock = std::chrono::steady_clock;
+
+	const auto origin = clock::now();
+	auto now = [origin] {
+		return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - origin).count());
+	};
+
+	std::vector<std::vector<stress_op>> histories(options.threads);
+	std::vector<std::uint64_t> torn(options.threads, 0);
+	std::atomic<bool> start{ false };
+
+	auto worker = [&](unsigned int index) {
+		std::mt19937_64 random(options.seed * 0x9e3779b97f4a7c15ull + index);
+		std::vector<stress_op>& history = histories[index];
+		history.reserve(options.ops_per_thread);
+		std::uint64_t& torn_count = torn[index];
+
+		bool yield_inside = false;
+		auto increment = [&](model& m) {
+			if (!m.consistent())
+				++torn_count;
+			std::uint64_t v = m.value() + 1;
+			for (std::size_t w = 0; w < std::size(m.words); ++w)
+			{
+				m.words[w] = v;
+				if (yield_inside && w == 0)
+					std::this_thread::yield();
+			}
+			return v;
+		};
+		auto observe = [&](const model& m) {
+			std::uint64_t v = m.value();
+			if (yield_inside)
+				std::this_thread::yield();
+			if (!m.consistent() || m.value() != v)
+				++torn_count;
+			return v;
+		};
+
+		while (!start.load(std::memory_order_acquire))
+			std::this_thread::yield();
+
+		for (unsigned int n = 0; n < options.ops_per_thread; ++n)
+		{
+			std::uint64_t r = random();
+			stress_op op;
+			op.write = r % 100 < options.write_percent;
+			bool use_guard = (r >> 8) & 1;
+			yield_inside = (r >> 32) % 100 < options.yield_inside_percent;
+
+			op.invoked = now();
+			if (op.write)
+			{
+				if constexpr (requires { backend.get_unique(); })
+				{
+					if (use_guard)
+					{
+						auto guard = backend.get_unique();
+						op.value = increment(*guard);
+					}
+					else
+						op.value = backend.write(increment);
+				}
+				else
+					op.value = backend.write(increment);
+			}
+			else
+			{
+				if constexpr (requires { backend.get_shared(); })
+				{
+					if (use_guard)
+					{
+						auto guard = backend.get_shared();
+						op.value = observe(*guard);
+					}
+					else
+						op.value = backend.read(observe);
+				}
+				else
+					op.value = backend.read(observe);
+			}
+			op.responded = now();
+			history.push_back(op);
+
+			if (options.max_pause != 0)
+			{
+				unsigned int pause = static_cast<unsigned int>((r >> 16) % options.max_pause);
+				if (pause == 0)
+					std::this_thread::yield();
+				for (unsigned int i = 0; i < pause; ++i)
+					spin_lock::pause();
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(options.threads);
+	for (unsigned int i = 0; i < options.threads; ++i)
+		threads.emplace_back(worker, i);
+	const auto started = clock::now();
+	start.store(true, std::memory_order_release);
+	for (auto& t : threads)
+		t.join();
+
+	stress_result result;
+	result.elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - started);
+	for (std::uint64_t t : torn)
+		result.torn_reads += t;
+
+	std::vector<stress_op> history;
+	for (auto& h : histories)
+		history.insert(history.end(), h.begin(), h.end());
+	std::uint64_t final_value = backend.read([](const model& m) { return m.value(); });
+	check_register_history(std::move(history), final_value, result);
+	return result;
+}
+#endif
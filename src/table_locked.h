@@ -0,0 +1,179 @@
+#ifndef TABLE_LOCKED
+#define TABLE_LOCKED
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <tuple>
+#include <utility>
+
+#include "protected_data.h"
+
+// table_stripe
+// 
+// One cache line of the global lock table, a std::shared_mutex padded so
+// that neighbouring stripes don't share a cache line
+class alignas(cache_line_size) table_stripe
+{
+	std::shared_mutex mutex_;
+
+public:
+	void lock() { mutex_.lock(); }
+	bool try_lock() { return mutex_.try_lock(); }
+	void unlock() { mutex_.unlock(); }
+	void lock_shared() { mutex_.lock_shared(); }
+	bool try_lock_shared() { return mutex_.try_lock_shared(); }
+	void unlock_shared() { mutex_.unlock_shared(); }
+};
+
+// lock_table
+// 
+// Global striped lock table of table_locked objects. The stripe of an object
+// is chosen by a Fibonacci hash of its address, distinct objects may share
+// a stripe. The table takes 64 KiB once for the whole program.
+struct lock_table
+{
+	static constexpr std::size_t stripes = 1024;
+	static constexpr int stripe_bits = 10;
+	static_assert(std::size_t(1) << stripe_bits == stripes);
+
+	static inline std::array<table_stripe, stripes> table_;
+
+	static std::size_t index_of(const void* object)
+	{
+		// low bits are zero because of alignment, the multiplication moves
+		// all address bits into the high bits that select the stripe
+		auto address = reinterpret_cast<std::uintptr_t>(object);
+		return std::size_t((std::uint64_t(address) * 0x9E3779B97F4A7C15ull) >> (64 - stripe_bits));
+	}
+
+	static table_stripe& stripe_of(const void* object)
+	{
+		return table_[index_of(object)];
+	}
+};
+
+// table_locked<T>
+// 
+// T : contained object type
+// 
+// Protected object without a mutex of its own, sizeof(table_locked<T>) is
+// sizeof(T). Guards lock the stripe of the object in the global lock_table,
+// get_unique() and get_shared() return the usual unique_guard and
+// shared_guard. Meant for large numbers of tiny objects whose own mutex
+// would take more space than the object.
+// 
+// Since unrelated objects may share a stripe, a thread must not hold a guard
+// of one table_locked while acquiring a guard of another, the stripes may be
+// the same (self-deadlock) or be taken in opposite order by another thread.
+// Use get_unique_all() to lock several objects at once.
+// 
+// e.g.
+// std::vector<table_locked<Point>> points(1'000'000);
+// points[5].get_unique()->x = 10;
+template<typename T>
+class table_locked
+{
+	T object_;
+
+	table_locked(const table_locked& other) = delete;
+	table_locked& operator=(const table_locked& other) = delete;
+
+	template<typename... Ts>
+	friend class table_unique_guard;
+
+public:
+	using value_type = T;
+
+	template<typename... Args>
+	table_locked(Args&&... args) : object_(std::forward<Args>(args)...) {};
+
+	// get_unique()
+	// 
+	// Acquires the exclusive lock of the stripe and returns a unique_guard
+	unique_guard<T, table_stripe> get_unique()
+	{
+		return unique_guard<T, table_stripe>(lock_table::stripe_of(this), object_);
+	}
+
+	// get_shared()
+	// 
+	// Acquires the shared lock of the stripe and returns a shared_guard
+	auto get_shared() const
+	{
+		return shared_guard<T, table_stripe>(lock_table::stripe_of(this), object_);
+	}
+
+	template<typename F>
+	auto read(F&& f) const
+	{
+		std::shared_lock lock(lock_table::stripe_of(this));
+		return std::invoke(std::forward<F>(f), std::as_const(object_));
+	}
+
+	template<typename F>
+	auto write(F&& f)
+	{
+		std::unique_lock lock(lock_table::stripe_of(this));
+		return std::invoke(std::forward<F>(f), object_);
+	}
+};
+
+// table_unique_guard<Ts...>
+// 
+// Ts : contained object types
+// 
+// Holds the exclusive locks of the stripes of several table_locked objects.
+// Stripes are locked once each in ascending index order, so concurrent
+// guards over overlapping sets of objects can't deadlock.
+// get<I>() returns the I-th object.
+template<typename... Ts>
+class table_unique_guard
+{
+	std::array<std::size_t, sizeof...(Ts)> stripes_;
+	std::size_t count_;
+	std::tuple<Ts&...> objects_;
+
+	table_unique_guard(const table_unique_guard& other) = delete;
+	table_unique_guard& operator=(table_unique_guard other) = delete;
+
+public:
+	explicit table_unique_guard(table_locked<Ts>&... objects)
+		: stripes_{ lock_table::index_of(&objects)... }, objects_(objects.object_...)
+	{
+		std::sort(stripes_.begin(), stripes_.end());
+		count_ = std::unique(stripes_.begin(), stripes_.end()) - stripes_.begin();
+		for (std::size_t i = 0; i < count_; ++i)
+			lock_table::table_[stripes_[i]].lock();
+	}
+
+	~table_unique_guard()
+	{
+		for (std::size_t i = count_; i-- > 0;)
+			lock_table::table_[stripes_[i]].unlock();
+	}
+
+	template<std::size_t I>
+	auto& get() const
+	{
+		return std::get<I>(objects_);
+	}
+};
+
+// get_unique_all()
+// 
+// Locks the stripes of all objects without deadlock and returns a
+// table_unique_guard, e.g.
+// auto guard = get_unique_all(from, to);
+// guard.get<0>().balance -= 10;
+// guard.get<1>().balance += 10;
+template<typename... Ts>
+table_unique_guard<Ts...> get_unique_all(table_locked<Ts>&... objects)
+{
+	return table_unique_guard<Ts...>(objects...);
+}
+#endif